@@ -0,0 +1,160 @@
+// AnnounceBench.cpp : One side of the announcement channel benchmark. Run many receivers and
+// one sender on the same machine (announce_spread.sh does that) to see how far apart the first
+// and the last receiver get each announcement, and what one write costs the sender.
+//
+// Usage: AnnounceBench send <receivers> [announcements] [interval_ms] [--key value...]
+//        AnnounceBench receive <announcements> [--key value...]
+//
+// send prints "index,send_us,write_us", receive prints "index,receive_us" (system clock, so the
+// numbers of different processes on one machine can be compared). "--announce-group off"
+// compares against one unicast copy per receiver.
+
+#include "UserChatPubSubTypes.hpp"
+#include "AnnouncementChannel.hpp"
+#include "ChatConfig.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int TIMEOUT_SECONDS = 120;
+
+long long wallMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+long long steadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int runSender(int receivers, int announcements, int interval_ms) {
+    AnnouncementChannel& channel = AnnouncementChannel::get();
+
+    if (!channel.init("bench_sender")) {
+        std::cerr << "Error creating the announcement channel." << std::endl;
+        return 1;
+    }
+
+    // The writer only exists after the first announcement, receivers ignore index 0
+    channel.announce("0");
+
+    long long deadline = steadyMicros() + TIMEOUT_SECONDS * 1000000LL;
+
+    // Its own reader counts too
+    while (channel.readerCount() < receivers + 1) {
+        if (steadyMicros() > deadline) {
+            std::cerr << "Only " << channel.readerCount() - 1 << " of " << receivers << " receivers matched." << std::endl;
+            return 1;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Repairs of the warm-up announcement to late readers are done before measuring
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    std::cout << "index,send_us,write_us" << std::endl;
+
+    for (int i = 1; i <= announcements; i++) {
+        long long send_us = wallMicros();
+        long long start = steadyMicros();
+
+        channel.announce(std::to_string(i));
+
+        long long write_us = steadyMicros() - start;
+        std::cout << i << "," << send_us << "," << write_us << std::endl;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+
+    // Receivers that lost something get it again before the writer goes away
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    channel.shutdown();
+    return 0;
+}
+
+int runReceiver(int announcements) {
+    std::mutex mtx;
+    std::vector<long long> received(announcements + 1, 0);
+    int count = 0;
+
+    AnnouncementChannel& channel = AnnouncementChannel::get();
+
+    channel.setHandler([&](const UserChat& sample) {
+        long long now = wallMicros();
+        int index = std::atoi(sample.message().c_str());
+
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (index < 1 || index > announcements || received[index] != 0) return;
+
+        received[index] = now;
+        count++;
+    });
+
+    if (!channel.init("bench_receiver")) {
+        std::cerr << "Error creating the announcement channel." << std::endl;
+        return 1;
+    }
+
+    long long deadline = steadyMicros() + TIMEOUT_SECONDS * 1000000LL;
+
+    while (steadyMicros() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (count == announcements) break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    channel.shutdown();
+
+    // Missing ones are left out
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (int i = 1; i <= announcements; i++) {
+        if (received[i] != 0) std::cout << i << "," << received[i] << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            if (!applyOption(chatConfig(), arg.substr(2), argv[++i])) return 1;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() >= 2 && positional[0] == "send") {
+        int receivers = std::atoi(positional[1].c_str());
+        int announcements = positional.size() > 2 ? std::atoi(positional[2].c_str()) : 20;
+        int interval_ms = positional.size() > 3 ? std::atoi(positional[3].c_str()) : 100;
+
+        return runSender(receivers, announcements, interval_ms);
+    }
+
+    if (positional.size() >= 2 && positional[0] == "receive") {
+        return runReceiver(std::atoi(positional[1].c_str()));
+    }
+
+    std::cerr << "Usage: " << argv[0] << " send <receivers> [announcements] [interval_ms] [--key value...]" << std::endl;
+    std::cerr << "       " << argv[0] << " receive <announcements> [--key value...]" << std::endl;
+    return 1;
+}
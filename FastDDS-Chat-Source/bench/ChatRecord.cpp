@@ -0,0 +1,145 @@
+// ChatRecord.cpp : Records every UserChat sample on the given topics, with its arrival time,
+// into a capture file for ChatReplay. Joins the network the same way FastDDSUser does
+// (chat_config.txt, ip_list.txt and "--key value" options). Press Enter to stop.
+//
+// Usage: ChatRecord <capture_file> <topic> [topic...] [--key value...]
+
+#include "UserChatPubSubTypes.hpp"
+#include "CaptureFile.hpp"
+#include "ChatConfig.hpp"
+#include "ChatParticipant.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+unsigned long long nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class RecordListener : public DataReaderListener {
+public:
+    CaptureWriter* capture;
+    uint32_t topic_id;
+    std::atomic<unsigned long long> received;
+    UserChat sample;
+
+    RecordListener(CaptureWriter* capture, uint32_t topic_id) : capture(capture), topic_id(topic_id), received(0) {}
+
+    void on_data_available(DataReader* reader) override {
+        SampleInfo info;
+
+        while (reader->take_next_sample(&sample, &info) == RETCODE_OK) {
+            if (!info.valid_data) continue;
+
+            capture->write(topic_id, nowMicros(), sample.index(), sample.picture(), sample.username(), sample.message());
+            received++;
+        }
+    }
+};
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            if (!applyOption(chatConfig(), arg.substr(2), argv[++i])) return 1;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " <capture_file> <topic> [topic...] [--key value...]" << std::endl;
+        return 1;
+    }
+
+    CaptureWriter capture;
+
+    if (!capture.open(positional[0])) {
+        std::cerr << "Could not create " << positional[0] << "." << std::endl;
+        return 1;
+    }
+
+    DomainParticipant* participant = ChatParticipant::acquire();
+
+    if (participant == nullptr) {
+        std::cerr << "Error creating participant." << std::endl;
+        return 1;
+    }
+
+    Subscriber* subscriber = participant->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+    std::vector<Topic*> topics;
+    std::vector<DataReader*> readers;
+    std::vector<std::unique_ptr<RecordListener>> listeners;
+
+    for (size_t i = 1; i < positional.size() && subscriber != nullptr; i++) {
+        const std::string& name = positional[i];
+        Topic* topic = participant->create_topic(name, "UserChat", TOPIC_QOS_DEFAULT);
+
+        if (topic == nullptr) {
+            std::cerr << "Error creating topic " << name << "." << std::endl;
+            continue;
+        }
+
+        // Signal topics are best-effort, a reliable reader wouldn't match them
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        bool signal = name.size() > 7 && name.compare(name.size() - 7, 7, "_signal") == 0;
+        readerQos.reliability().kind = signal ? BEST_EFFORT_RELIABILITY_QOS : RELIABLE_RELIABILITY_QOS;
+        readerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+
+        listeners.emplace_back(new RecordListener(&capture, capture.addTopic(name)));
+        DataReader* reader = subscriber->create_datareader(topic, readerQos, listeners.back().get());
+
+        topics.push_back(topic);
+        if (reader != nullptr) readers.push_back(reader);
+    }
+
+    if (readers.empty()) {
+        std::cerr << "Nothing to record." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Recording " << readers.size() << " topic(s) to " << positional[0] << ", press Enter to stop." << std::endl;
+
+    unsigned long long start = nowMicros();
+    std::string line;
+    std::getline(std::cin, line);
+
+    for (DataReader* reader : readers) {
+        subscriber->delete_datareader(reader);
+    }
+    for (Topic* topic : topics) {
+        participant->delete_topic(topic);
+    }
+    participant->delete_subscriber(subscriber);
+    ChatParticipant::release();
+
+    double seconds = (nowMicros() - start) / 1000000.0;
+    uint64_t samples = capture.sampleCount();
+
+    if (!capture.close()) {
+        std::cerr << "Error writing " << positional[0] << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Recorded " << samples << " samples in " << seconds << " s." << std::endl;
+    return 0;
+}
@@ -0,0 +1,152 @@
+// ChatReplay.cpp : Publishes a capture from ChatRecord again through UserChatPublisher, keeping
+// its timing at 1x, scaled by a speed factor, or as fast as the writers take it ("max").
+// Waits for a reader on every topic first, e.g. FastDDSUser or a ChatRecord on another box.
+// Messages get new indexes from the publisher, the recorded ones are only used for the report.
+// Nothing is written to ChatLogs: the publishers keep no outbox log, so indexes start at 1.
+//
+// Usage: ChatReplay <capture_file> [speed|max] [--key value...]
+
+#include "UserChatPubSubTypes.hpp"
+#include "CaptureFile.hpp"
+#include "ChatConfig.hpp"
+#include "ChatHistory.hpp"
+#include "Reactor.hpp"
+#include "UserChatPublisher.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int MATCH_TIMEOUT_S = 30;
+
+struct ReplayTopic {
+    std::unique_ptr<ChatHistory> history;
+    std::unique_ptr<UserChatPublisher> pub;
+};
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            if (!applyOption(chatConfig(), arg.substr(2), argv[++i])) return 1;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    double speed = positional.size() > 1 && positional[1] != "max" ? std::atof(positional[1].c_str()) : 0;
+    bool max_speed = positional.size() > 1 && positional[1] == "max";
+
+    if (positional.empty() || (!max_speed && positional.size() > 1 && speed <= 0)) {
+        std::cerr << "Usage: " << argv[0] << " <capture_file> [speed|max] [--key value...]" << std::endl;
+        return 1;
+    }
+
+    if (positional.size() == 1) speed = 1;
+
+    // First pass finds the topics and who sent on them
+    std::map<std::string, ReplayTopic> topics;
+    CaptureReader reader;
+    CaptureSample sample;
+    uint64_t total = 0;
+    uint64_t duration_us = 0;
+
+    if (!reader.open(positional[0])) {
+        std::cerr << positional[0] << " isn't a capture file." << std::endl;
+        return 1;
+    }
+
+    while (reader.next(sample)) {
+        ReplayTopic& topic = topics[sample.topic];
+
+        if (!topic.pub) {
+            topic.history.reset(new ChatHistory());
+            topic.pub.reset(new UserChatPublisher(sample.topic, sample.username, topic.history.get()));
+            topic.pub->setLogFile("");
+
+            if (!topic.pub->init()) {
+                std::cerr << "Error creating publisher for " << sample.topic << "." << std::endl;
+                return 1;
+            }
+        }
+
+        duration_us = sample.time_us;
+        total++;
+    }
+
+    std::cout << "Waiting for readers on " << topics.size() << " topic(s)..." << std::endl;
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(MATCH_TIMEOUT_S);
+
+    for (std::map<std::string, ReplayTopic>::iterator it = topics.begin(); it != topics.end(); ++it) {
+        while (!it->second.pub->getStatus() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (!it->second.pub->getStatus()) {
+            std::cerr << "Nobody is reading " << it->first << "." << std::endl;
+            return 1;
+        }
+    }
+
+    // Second pass publishes
+    CaptureReader replay;
+    replay.open(positional[0]);
+
+    uint64_t sent = 0, retries = 0, dropped = 0;
+    long long worst_late_us = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (replay.next(sample)) {
+        if (!max_speed) {
+            std::chrono::steady_clock::time_point due = start
+                + std::chrono::microseconds(static_cast<long long>(sample.time_us / speed));
+            std::this_thread::sleep_until(due);
+
+            long long late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - due).count();
+            if (late > worst_late_us) worst_late_us = late;
+        }
+
+        UserChatPublisher* pub = topics[sample.topic].pub.get();
+        PublishResult result = pub->tryPublish(sample.message);
+
+        // Back off while the reader catches up, like flushOutbox() does
+        while (result == PUBLISH_QUEUE_FULL) {
+            retries++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            result = pub->tryPublish(sample.message);
+        }
+
+        if (result == PUBLISH_OK) sent++;
+        else dropped++;
+    }
+
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000000.0;
+
+    std::cout << "samples,sent,dropped,queue_full_retries,recorded_s,replay_s,msgs_per_s,worst_late_ms" << std::endl;
+    std::cout << total << "," << sent << "," << dropped << "," << retries << ","
+        << duration_us / 1000000.0 << "," << seconds << "," << (seconds > 0 ? sent / seconds : 0) << ","
+        << worst_late_us / 1000.0 << std::endl;
+
+    // Let the readers acknowledge everything before the writers go away
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    for (std::map<std::string, ReplayTopic>::iterator it = topics.begin(); it != topics.end(); ++it) {
+        it->second.pub->stop();
+    }
+
+    Reactor::get().sync();
+    topics.clear();
+
+    return dropped == 0 ? 0 : 1;
+}
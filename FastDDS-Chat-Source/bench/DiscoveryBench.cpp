@@ -0,0 +1,162 @@
+// DiscoveryBench.cpp : Time until every participant has discovered every other one,
+// with simple discovery and with a Discovery Server, for a growing number of participants.
+//
+// Usage: DiscoveryBench <simple|server> [max_participants]
+// Run it through discovery_packets.sh to also count the RTPS packets that were sent.
+// Everything goes over UDPv4, without shared memory or intraprocess delivery, so all of
+// discovery shows up on the network.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/LibrarySettings.hpp>
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/domain/DomainParticipantListener.hpp>
+#include <fastdds/rtps/transport/UDPv4TransportDescriptor.hpp>
+#include <fastdds/utils/IPLocator.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+const uint16_t BENCH_SERVER_PORT = 11911;
+const int TIMEOUT_SECONDS = 120;
+
+// Counts the other bench participants this participant knows about
+class CountingListener : public DomainParticipantListener {
+public:
+    std::atomic<int> discovered;
+
+    CountingListener() : discovered(0) {}
+
+    void on_participant_discovery(DomainParticipant*, eprosima::fastdds::rtps::ParticipantDiscoveryStatus reason,
+        const eprosima::fastdds::rtps::ParticipantBuiltinTopicData& info, bool&) override {
+        // The server itself doesn't count
+        if (info.participant_name.to_string().find("bench_") != 0) return;
+
+        if (reason == eprosima::fastdds::rtps::ParticipantDiscoveryStatus::DISCOVERED_PARTICIPANT) discovered++;
+        else if (reason == eprosima::fastdds::rtps::ParticipantDiscoveryStatus::REMOVED_PARTICIPANT ||
+            reason == eprosima::fastdds::rtps::ParticipantDiscoveryStatus::DROPPED_PARTICIPANT) discovered--;
+    }
+};
+
+void useUdpOnly(DomainParticipantQos& participantQos) {
+    std::shared_ptr<eprosima::fastdds::rtps::UDPv4TransportDescriptor> udp(new eprosima::fastdds::rtps::UDPv4TransportDescriptor());
+    participantQos.transport().use_builtin_transports = false;
+    participantQos.transport().user_transports.push_back(udp);
+}
+
+DomainParticipant* createServer() {
+    DomainParticipantQos participantQos;
+    participantQos.name("server");
+    useUdpOnly(participantQos);
+
+    eprosima::fastdds::rtps::Locator_t locator;
+    eprosima::fastdds::rtps::IPLocator::setIPv4(locator, "127.0.0.1");
+    locator.port = BENCH_SERVER_PORT;
+
+    participantQos.wire_protocol().builtin.discovery_config.discoveryProtocol = eprosima::fastdds::rtps::DiscoveryProtocol::SERVER;
+    participantQos.wire_protocol().builtin.metatrafficUnicastLocatorList.push_back(locator);
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+}
+
+DomainParticipant* createParticipant(int id, bool use_server, CountingListener* listener) {
+    DomainParticipantQos participantQos;
+    participantQos.name("bench_" + std::to_string(id));
+    useUdpOnly(participantQos);
+
+    if (use_server) {
+        eprosima::fastdds::rtps::Locator_t server;
+        eprosima::fastdds::rtps::IPLocator::setIPv4(server, "127.0.0.1");
+        server.port = BENCH_SERVER_PORT;
+
+        participantQos.wire_protocol().builtin.discovery_config.discoveryProtocol = eprosima::fastdds::rtps::DiscoveryProtocol::CLIENT;
+        participantQos.wire_protocol().builtin.discovery_config.m_DiscoveryServers.push_back(server);
+    }
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos, listener);
+}
+
+// Returns milliseconds until full discovery, or -1 on timeout
+long long runRound(int count, bool use_server) {
+    std::vector<std::unique_ptr<CountingListener>> listeners;
+    std::vector<DomainParticipant*> participants;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; i++) {
+        listeners.push_back(std::unique_ptr<CountingListener>(new CountingListener()));
+        participants.push_back(createParticipant(i, use_server, listeners.back().get()));
+    }
+
+    long long elapsed = -1;
+
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(TIMEOUT_SECONDS)) {
+        bool done = true;
+
+        for (std::unique_ptr<CountingListener>& listener : listeners) {
+            if (listener->discovered.load() < count - 1) {
+                done = false;
+                break;
+            }
+        }
+
+        if (done) {
+            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    for (DomainParticipant* participant : participants) {
+        if (participant != nullptr) DomainParticipantFactory::get_instance()->delete_participant(participant);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || (std::string(argv[1]) != "simple" && std::string(argv[1]) != "server")) {
+        std::cerr << "Usage: " << argv[0] << " <simple|server> [max_participants]" << std::endl;
+        return 1;
+    }
+
+    bool use_server = std::string(argv[1]) == "server";
+    int max_participants = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    eprosima::fastdds::LibrarySettings library_settings;
+    library_settings.intraprocess_delivery = eprosima::fastdds::IntraprocessDeliveryType::INTRAPROCESS_OFF;
+    DomainParticipantFactory::get_instance()->set_library_settings(library_settings);
+
+    DomainParticipant* server = nullptr;
+
+    if (use_server) {
+        server = createServer();
+
+        if (server == nullptr) {
+            std::cerr << "Error creating discovery server." << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "mode,participants,discovery_ms" << std::endl;
+
+    for (int count = 10; count <= max_participants; count *= 2) {
+        std::cout << argv[1] << "," << count << "," << runRound(count, use_server) << std::endl;
+
+        // Let the removed participants leave before the next round
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+
+    if (server != nullptr) DomainParticipantFactory::get_instance()->delete_participant(server);
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+// PartitionBench.cpp : Cost of matching a shared topic (like the presence topic) when everyone
+// is in one big group, when each room has its own partition, and when rooms are also sharded
+// over several domains. Every participant has one writer and one reader on "bench_room".
+//
+// Usage: PartitionBench <flat|partition|shard> [max_participants] [rooms]
+//
+// matched_ms is the time until every reader has matched every writer of its room (all of them
+// when flat). writers_seen is how many remote writers a participant learned about through
+// endpoint discovery (SEDP): partitions only stop the matching, so it stays at everyone;
+// shards keep it to the participants on the same domain.
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "QosProfiles.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/domain/DomainParticipantListener.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+const int TIMEOUT_SECONDS = 120;
+
+// Writers this participant discovered and how many its reader matched
+class BenchListener : public DomainParticipantListener {
+public:
+    std::atomic<int> writers_seen;
+    std::atomic<int> matched;
+
+    BenchListener() : writers_seen(0), matched(0) {}
+
+    void on_data_writer_discovery(DomainParticipant*, eprosima::fastdds::rtps::WriterDiscoveryStatus reason,
+        const PublicationBuiltinTopicData&, bool&) override {
+        if (reason == eprosima::fastdds::rtps::WriterDiscoveryStatus::DISCOVERED_WRITER) writers_seen++;
+        else if (reason == eprosima::fastdds::rtps::WriterDiscoveryStatus::REMOVED_WRITER) writers_seen--;
+    }
+
+    void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override {
+        matched = info.current_count;
+    }
+};
+
+struct BenchMember {
+    DomainParticipant* participant;
+    std::unique_ptr<BenchListener> listener;
+    int expected;       // Writers the reader should match, its own included
+};
+
+// Settings the chat would use for a member of this room
+ChatConfig roomConfig(const std::string& mode, int room, int rooms) {
+    ChatConfig config;
+
+    if (mode != "flat") config.partition = "room_" + std::to_string(room);
+    if (mode == "shard") config.partition_shards = static_cast<unsigned int>(rooms);
+
+    return config;
+}
+
+BenchMember createMember(int id, const ChatConfig& config) {
+    BenchMember member;
+    member.listener.reset(new BenchListener());
+    member.expected = 0;
+
+    DomainParticipantQos participantQos;
+    participantQos.name("bench_" + std::to_string(id));
+
+    member.participant = DomainParticipantFactory::get_instance()->create_participant(chatDomainId(config), participantQos,
+        member.listener.get());
+
+    if (member.participant == nullptr) return member;
+
+    TypeSupport type(new UserChatPubSubType());
+    type.register_type(member.participant);
+
+    Topic* topic = member.participant->create_topic("bench_room", "UserChat", TOPIC_QOS_DEFAULT);
+    Publisher* publisher = member.participant->create_publisher(chatPublisherQos(config), nullptr);
+    Subscriber* subscriber = member.participant->create_subscriber(chatSubscriberQos(config), nullptr);
+
+    if (topic == nullptr || publisher == nullptr || subscriber == nullptr) return member;
+
+    // Same settings as the presence topic
+    DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+    writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    writerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+
+    DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+    readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    readerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+
+    publisher->create_datawriter(topic, writerQos, nullptr);
+    subscriber->create_datareader(topic, readerQos, member.listener.get(), StatusMask::subscription_matched());
+
+    return member;
+}
+
+// Prints one CSV row, matched_ms is -1 on timeout
+void runRound(const std::string& mode, int count, int rooms) {
+    std::vector<BenchMember> members;
+    std::map<std::string, int> room_sizes;
+    std::vector<std::string> room_of;
+
+    for (int i = 0; i < count; i++) {
+        ChatConfig config = roomConfig(mode, i % rooms, rooms);
+        room_sizes[config.partition]++;
+        room_of.push_back(config.partition);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; i++) {
+        members.push_back(createMember(i, roomConfig(mode, i % rooms, rooms)));
+        members.back().expected = room_sizes[room_of[i]];
+    }
+
+    long long elapsed = -1;
+
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(TIMEOUT_SECONDS)) {
+        bool done = true;
+
+        for (BenchMember& member : members) {
+            if (member.listener->matched.load() < member.expected) {
+                done = false;
+                break;
+            }
+        }
+
+        if (done) {
+            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // Discovery keeps going for a moment after the last match, let it settle before counting
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    long long matches = 0, writers_seen = 0;
+
+    for (BenchMember& member : members) {
+        matches += member.listener->matched.load();
+        writers_seen += member.listener->writers_seen.load();
+    }
+
+    std::cout << mode << "," << count << "," << rooms << "," << elapsed << ","
+        << static_cast<double>(matches) / count << "," << static_cast<double>(writers_seen) / count << std::endl;
+
+    for (BenchMember& member : members) {
+        if (member.participant == nullptr) continue;
+
+        member.participant->delete_contained_entities();
+        DomainParticipantFactory::get_instance()->delete_participant(member.participant);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode != "flat" && mode != "partition" && mode != "shard") {
+        std::cerr << "Usage: " << argv[0] << " <flat|partition|shard> [max_participants] [rooms]" << std::endl;
+        return 1;
+    }
+
+    int max_participants = argc > 2 ? std::atoi(argv[2]) : 80;
+    int rooms = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    if (rooms < 1 || rooms > 233) {
+        std::cerr << "Rooms should be between 1 and 233." << std::endl;
+        return 1;
+    }
+
+    std::cout << "mode,participants,rooms,matched_ms,matches_per_reader,writers_seen" << std::endl;
+
+    for (int count = 10; count <= max_participants; count *= 2) {
+        runRound(mode, count, rooms);
+
+        // Let the removed participants leave before the next round
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+// PriorityBench.cpp : Latency of small urgent messages while a bulk transfer keeps the chat
+// flow controller busy, over UDP on loopback. "lane" sends them through a priority lane writer
+// (applyUrgentQos), "shared" through the bulk writer like any other message.
+//
+// Usage: PriorityBench <lane|shared> [seconds] [bulk_bytes] [--key value...]
+// "--flow-limit <KB/s>" caps the bulk writer like a slow link would.
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "QosProfiles.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/LibrarySettings.hpp>
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+#include <fastdds/rtps/transport/UDPv4TransportDescriptor.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// How often an urgent message is sent
+const int URGENT_INTERVAL_MS = 10;
+
+long long nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Urgent messages are "U<send time>", bulk ones are only counted
+class BenchListener : public DataReaderListener {
+public:
+    std::mutex mtx;
+    std::vector<long long> latencies;
+    std::atomic<int> matched;
+    std::atomic<unsigned long long> bulk_bytes;
+    UserChat sample;
+
+    BenchListener() : matched(0), bulk_bytes(0) {}
+
+    void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override {
+        matched = info.current_count;
+    }
+
+    void on_data_available(DataReader* reader) override {
+        SampleInfo info;
+
+        while (reader->take_next_sample(&sample, &info) == RETCODE_OK) {
+            if (!info.valid_data) continue;
+
+            if (sample.message().compare(0, 1, "U") == 0) {
+                long long latency = nowMicros() - std::strtoll(sample.message().c_str() + 1, nullptr, 10);
+
+                std::lock_guard<std::mutex> lock(mtx);
+                latencies.push_back(latency);
+            }
+            else {
+                bulk_bytes += sample.message().size();
+            }
+        }
+    }
+};
+
+// UDP only, so the data really goes through the network stack and the flow controller
+DomainParticipant* createParticipant(const ChatConfig& config, const std::string& name) {
+    DomainParticipantQos participantQos;
+    participantQos.name(name);
+
+    std::shared_ptr<eprosima::fastdds::rtps::UDPv4TransportDescriptor> udp(new eprosima::fastdds::rtps::UDPv4TransportDescriptor());
+    participantQos.transport().use_builtin_transports = false;
+    participantQos.transport().user_transports.push_back(udp);
+
+    addChatFlowController(participantQos, config);
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    ChatConfig& config = chatConfig();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            if (!applyOption(config, arg.substr(2), argv[++i])) return 1;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.empty() || (positional[0] != "lane" && positional[0] != "shared")) {
+        std::cerr << "Usage: " << argv[0] << " <lane|shared> [seconds] [bulk_bytes] [--key value...]" << std::endl;
+        return 1;
+    }
+
+    bool lane = positional[0] == "lane";
+    int seconds = positional.size() > 1 ? std::atoi(positional[1].c_str()) : 10;
+    size_t bulk_bytes = positional.size() > 2 ? static_cast<size_t>(std::atoi(positional[2].c_str())) : 65536;
+
+    // The bulk profile is the one that writes asynchronously through the flow controller
+    config.qos_profile = "bulk";
+
+    eprosima::fastdds::LibrarySettings library_settings;
+    library_settings.intraprocess_delivery = eprosima::fastdds::IntraprocessDeliveryType::INTRAPROCESS_OFF;
+    DomainParticipantFactory::get_instance()->set_library_settings(library_settings);
+
+    DomainParticipant* sub_participant = createParticipant(config, "bench_receiver");
+    DomainParticipant* pub_participant = createParticipant(config, "bench_sender");
+
+    if (sub_participant == nullptr || pub_participant == nullptr) {
+        std::cerr << "Error creating participants." << std::endl;
+        return 1;
+    }
+
+    TypeSupport type(new UserChatPubSubType());
+    type.register_type(sub_participant);
+    type.register_type(pub_participant);
+
+    Subscriber* subscriber = sub_participant->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+    Publisher* publisher = pub_participant->create_publisher(PUBLISHER_QOS_DEFAULT, nullptr);
+
+    Topic* sub_topic = sub_participant->create_topic("bench_chat", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* pub_topic = pub_participant->create_topic("bench_chat", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* sub_urgent_topic = sub_participant->create_topic("bench_chat_urgent", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* pub_urgent_topic = pub_participant->create_topic("bench_chat_urgent", "UserChat", TOPIC_QOS_DEFAULT);
+
+    DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+    applyQosProfile(readerQos, subscriber, config);
+
+    // The bulk writer waits for room instead of failing, so it keeps the controller busy
+    DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+    applyQosProfile(writerQos, publisher, config);
+    writerQos.reliability().max_blocking_time = msToDuration(60000);
+
+    DataReaderQos urgentReaderQos = DATAREADER_QOS_DEFAULT;
+    applyUrgentQos(urgentReaderQos);
+
+    DataWriterQos urgentWriterQos = DATAWRITER_QOS_DEFAULT;
+    applyUrgentQos(urgentWriterQos, writerQos.publish_mode());
+
+    BenchListener listener;
+    DataReader* reader = subscriber->create_datareader(sub_topic, readerQos, &listener);
+    DataReader* urgent_reader = subscriber->create_datareader(sub_urgent_topic, urgentReaderQos, &listener);
+    DataWriter* writer = publisher->create_datawriter(pub_topic, writerQos, nullptr);
+    DataWriter* urgent_writer = publisher->create_datawriter(pub_urgent_topic, urgentWriterQos, nullptr);
+
+    if (reader == nullptr || urgent_reader == nullptr || writer == nullptr || urgent_writer == nullptr) {
+        std::cerr << "Error creating endpoints." << std::endl;
+        return 1;
+    }
+
+    while (listener.matched.load() < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic<bool> running(true);
+    long long start = nowMicros();
+
+    std::thread bulk([&]() {
+        UserChat sample;
+        sample.username("bulk");
+        sample.message(std::string(bulk_bytes, 'x'));
+
+        for (uint32_t i = 1; running.load(); i++) {
+            sample.index(i);
+            writer->write(&sample);
+        }
+    });
+
+    // Let the bulk transfer fill the queue first
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    UserChat urgent;
+    urgent.username("urgent");
+    int urgent_sent = 0;
+
+    while (nowMicros() - start < seconds * 1000000LL) {
+        urgent.index(static_cast<uint32_t>(++urgent_sent));
+        urgent.message("U" + std::to_string(nowMicros()));
+        (lane ? urgent_writer : writer)->write(&urgent);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(URGENT_INTERVAL_MS));
+    }
+
+    running = false;
+    bulk.join();
+
+    double elapsed = (nowMicros() - start) / 1000000.0;
+
+    // Whatever is still queued gets a moment to arrive
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    std::lock_guard<std::mutex> lock(listener.mtx);
+    std::vector<long long>& latencies = listener.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    size_t count = latencies.size();
+
+    std::cout << "mode,flow_limit_KBps,bulk_bytes,bulk_MB_per_s,urgent_sent,urgent_received,p50_us,p99_us,max_us" << std::endl;
+    std::cout << positional[0] << "," << config.flow_limit_kbps << "," << bulk_bytes << ","
+        << listener.bulk_bytes.load() / elapsed / 1000000.0 << ","
+        << urgent_sent << "," << count << ","
+        << (count ? latencies[count / 2] : 0) << ","
+        << (count ? latencies[count * 99 / 100] : 0) << ","
+        << (count ? latencies[count - 1] : 0) << std::endl;
+
+    publisher->delete_datawriter(writer);
+    publisher->delete_datawriter(urgent_writer);
+    subscriber->delete_datareader(reader);
+    subscriber->delete_datareader(urgent_reader);
+    pub_participant->delete_contained_entities();
+    sub_participant->delete_contained_entities();
+    DomainParticipantFactory::get_instance()->delete_participant(pub_participant);
+    DomainParticipantFactory::get_instance()->delete_participant(sub_participant);
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// SerializationBench.cpp : ns and bytes per operation for the size calculation, serialize and
+// deserialize of the generated UserChatPubSubType and the hand-written UserChatFastPubSubType,
+// with XCDRv1 (PLAIN_CDR) and XCDRv2 (DELIMIT_CDR2), for messages from 0 bytes to 64 KB.
+// Also checks that each type reads what the other wrote. No DDS entities are created.
+// Every case runs for at least min_ms, doubling the iterations until it does.
+//
+// Usage: SerializationBench [min_ms]
+
+#include "UserChatPubSubTypes.hpp"
+#include "UserChatFastType.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fastdds/rtps/common/SerializedPayload.hpp>
+
+using namespace eprosima::fastdds::dds;
+using eprosima::fastdds::rtps::SerializedPayload_t;
+
+const size_t MESSAGE_SIZES[] = { 0, 16, 64, 256, 1024, 4096, 16384, 65536 };
+
+// Written after every run so the compiler can't drop the work
+volatile uint64_t sink = 0;
+
+long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs op iterations times per round until a round takes min_ns, returns ns per call
+template <typename Op>
+double measure(long long min_ns, Op op) {
+    uint64_t iterations = 16;
+
+    while (true) {
+        uint64_t total = 0;
+        long long start = nowNanos();
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            total += op();
+        }
+
+        long long elapsed = nowNanos() - start;
+        sink = sink + total;
+
+        if (elapsed >= min_ns || iterations >= (1ULL << 30)) {
+            return static_cast<double>(elapsed) / iterations;
+        }
+
+        iterations *= 2;
+    }
+}
+
+void printRow(const char* type, const char* encoding, const char* op, size_t message_bytes, double ns, uint32_t bytes) {
+    std::cout << type << "," << encoding << "," << op << "," << message_bytes << "," << ns << "," << bytes << ","
+        << (ns > 0 ? bytes / ns * 1000.0 : 0) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    long long min_ns = (argc > 1 ? std::atoll(argv[1]) : 200) * 1000000LL;
+
+    struct Encoding {
+        const char* name;
+        DataRepresentationId_t id;
+    };
+
+    const Encoding encodings[] = {
+        { "xcdr1_plain", XCDR_DATA_REPRESENTATION },
+        { "xcdr2_delimit", XCDR2_DATA_REPRESENTATION },
+    };
+
+    UserChatPubSubType generated;
+    UserChatFastPubSubType fast;
+
+    struct Type {
+        const char* name;
+        TopicDataType* support;
+    };
+
+    const Type types[] = {
+        { "generated", &generated },
+        { "fast", &fast },
+    };
+
+    UserChat sample;
+    UserChat out;
+
+    sample.index(123456);
+    sample.username("benchmark_user");
+    sample.picture(7);
+
+    std::cout << "type,encoding,op,message_bytes,ns_per_op,bytes_per_op,mb_per_s" << std::endl;
+
+    for (size_t size : MESSAGE_SIZES) {
+        sample.message(std::string(size, 'x'));
+
+        for (const Encoding& encoding : encodings) {
+            for (const Type& type : types) {
+                uint32_t bytes = type.support->calculate_serialized_size(&sample, encoding.id);
+                SerializedPayload_t payload(bytes);
+
+                double ns = measure(min_ns, [&]() {
+                    return type.support->calculate_serialized_size(&sample, encoding.id);
+                });
+                printRow(type.name, encoding.name, "size", size, ns, bytes);
+
+                ns = measure(min_ns, [&]() {
+                    payload.length = 0;
+                    type.support->serialize(&sample, payload, encoding.id);
+                    return payload.length;
+                });
+                printRow(type.name, encoding.name, "serialize", size, ns, payload.length);
+
+                if (payload.length != bytes) {
+                    std::cerr << type.name << " " << encoding.name << " wrote " << payload.length
+                        << " bytes, size said " << bytes << "." << std::endl;
+                }
+
+                ns = measure(min_ns, [&]() {
+                    type.support->deserialize(payload, &out);
+                    return static_cast<uint32_t>(out.message().size());
+                });
+                printRow(type.name, encoding.name, "deserialize", size, ns, payload.length);
+
+                // The other type has to read it the same way, or the two can't be mixed on one network
+                TopicDataType* other = type.support == &generated ? static_cast<TopicDataType*>(&fast) : &generated;
+                out = UserChat();
+
+                if (!other->deserialize(payload, &out) || out.message() != sample.message()
+                    || out.username() != sample.username() || out.index() != sample.index() || out.picture() != sample.picture()) {
+                    std::cerr << "What " << type.name << " wrote with " << encoding.name << " doesn't read back the same." << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+// SignalBench.cpp : Chat message latency with and without a flood of typing signals on the
+// best-effort signal topic. Signals are written straight to the topic, without the per-peer
+// rate limit of SignalChannel, to show the two topics don't slow each other down.
+//
+// Usage: SignalBench [chat_messages] [typing_per_s]
+
+#include "UserChatPubSubTypes.hpp"
+#include "QosProfiles.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/LibrarySettings.hpp>
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Chat messages are sent at a steady human-ish rate while the signals flow
+const int CHAT_INTERVAL_MS = 10;
+
+long long nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ChatListener : public DataReaderListener {
+public:
+    std::mutex mtx;
+    std::vector<long long> latencies;
+    std::atomic<int> matched;
+    UserChat sample;
+
+    ChatListener() : matched(0) {}
+
+    void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override {
+        matched = info.current_count;
+    }
+
+    void on_data_available(DataReader* reader) override {
+        SampleInfo info;
+
+        while (reader->take_next_sample(&sample, &info) == RETCODE_OK) {
+            if (!info.valid_data) continue;
+
+            long long sent = std::strtoll(sample.message().c_str(), nullptr, 10);
+
+            std::lock_guard<std::mutex> lock(mtx);
+            latencies.push_back(nowMicros() - sent);
+        }
+    }
+
+    size_t count() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return latencies.size();
+    }
+};
+
+class SignalListener : public DataReaderListener {
+public:
+    std::atomic<int> received;
+    std::atomic<int> matched;
+    UserChat sample;
+
+    SignalListener() : received(0), matched(0) {}
+
+    void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override {
+        matched = info.current_count;
+    }
+
+    void on_data_available(DataReader* reader) override {
+        SampleInfo info;
+
+        while (reader->take_next_sample(&sample, &info) == RETCODE_OK) {
+            if (info.valid_data) received++;
+        }
+    }
+};
+
+DomainParticipant* createParticipant(const std::string& name) {
+    DomainParticipantQos participantQos;
+    participantQos.name(name);
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+}
+
+// Sends chat messages while typing_per_s signals are written, prints one CSV row
+void runPhase(const std::string& phase, int messages, int typing_per_s,
+    DataWriter* chat_writer, DataWriter* signal_writer, ChatListener& chat_listener, SignalListener& signal_listener) {
+    {
+        std::lock_guard<std::mutex> lock(chat_listener.mtx);
+        chat_listener.latencies.clear();
+    }
+    signal_listener.received = 0;
+
+    std::atomic<bool> flooding(typing_per_s > 0);
+    std::atomic<int> signals_sent(0);
+    std::thread flood;
+
+    if (typing_per_s > 0) {
+        flood = std::thread([&]() {
+            UserChat signal;
+            signal.username("bench");
+            signal.message("typing");
+
+            std::chrono::microseconds period(1000000 / typing_per_s);
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+            while (flooding) {
+                signal_writer->write(&signal);
+                signals_sent++;
+
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    UserChat sample;
+    sample.username("bench");
+
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < messages; i++) {
+        sample.index(static_cast<uint32_t>(i + 1));
+        sample.message(std::to_string(nowMicros()) + " hello");
+        chat_writer->write(&sample);
+
+        next += std::chrono::milliseconds(CHAT_INTERVAL_MS);
+        std::this_thread::sleep_until(next);
+    }
+
+    chat_writer->wait_for_acknowledgments(msToDuration(10000));
+
+    long long deadline = nowMicros() + 10000000LL;
+    while (chat_listener.count() < static_cast<size_t>(messages) && nowMicros() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    flooding = false;
+    if (flood.joinable()) flood.join();
+
+    std::lock_guard<std::mutex> lock(chat_listener.mtx);
+    std::vector<long long>& latencies = chat_listener.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    size_t count = latencies.size();
+
+    std::cout << phase << "," << typing_per_s << "," << signals_sent.load() << "," << signal_listener.received.load() << ","
+        << messages << "," << count << ","
+        << (count ? latencies[count / 2] : 0) << ","
+        << (count ? latencies[count * 99 / 100] : 0) << ","
+        << (count ? latencies[count - 1] : 0) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int messages = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int typing_per_s = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    if (messages <= 0 || typing_per_s < 0 || typing_per_s > 1000000) {
+        std::cerr << "Usage: " << argv[0] << " [chat_messages] [typing_per_s]" << std::endl;
+        return 1;
+    }
+
+    // Both ends live in this process, make sure samples still go through a transport
+    eprosima::fastdds::LibrarySettings library_settings;
+    library_settings.intraprocess_delivery = eprosima::fastdds::IntraprocessDeliveryType::INTRAPROCESS_OFF;
+    DomainParticipantFactory::get_instance()->set_library_settings(library_settings);
+
+    DomainParticipant* sub_participant = createParticipant("bench_receiver");
+    DomainParticipant* pub_participant = createParticipant("bench_sender");
+
+    if (sub_participant == nullptr || pub_participant == nullptr) {
+        std::cerr << "Error creating participants." << std::endl;
+        return 1;
+    }
+
+    TypeSupport type(new UserChatPubSubType());
+    type.register_type(sub_participant);
+    type.register_type(pub_participant);
+
+    Topic* sub_chat_topic = sub_participant->create_topic("bench_a_b", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* pub_chat_topic = pub_participant->create_topic("bench_a_b", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* sub_signal_topic = sub_participant->create_topic("bench_a_b_signal", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* pub_signal_topic = pub_participant->create_topic("bench_a_b_signal", "UserChat", TOPIC_QOS_DEFAULT);
+
+    Subscriber* subscriber = sub_participant->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+    Publisher* publisher = pub_participant->create_publisher(PUBLISHER_QOS_DEFAULT, nullptr);
+
+    // Chat topic as the chat sets it up, but every message has to arrive to be measured
+    DataReaderQos chatReaderQos = DATAREADER_QOS_DEFAULT;
+    chatReaderQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    chatReaderQos.history().kind = KEEP_ALL_HISTORY_QOS;
+
+    DataWriterQos chatWriterQos = DATAWRITER_QOS_DEFAULT;
+    chatWriterQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    chatWriterQos.history().kind = KEEP_ALL_HISTORY_QOS;
+
+    // Signal topic as SignalChannel sets it up
+    DataReaderQos signalReaderQos = DATAREADER_QOS_DEFAULT;
+    signalReaderQos.reliability().kind = BEST_EFFORT_RELIABILITY_QOS;
+    signalReaderQos.durability().kind = VOLATILE_DURABILITY_QOS;
+    signalReaderQos.history().kind = KEEP_LAST_HISTORY_QOS;
+    signalReaderQos.history().depth = 1;
+
+    DataWriterQos signalWriterQos = DATAWRITER_QOS_DEFAULT;
+    signalWriterQos.reliability().kind = BEST_EFFORT_RELIABILITY_QOS;
+    signalWriterQos.durability().kind = VOLATILE_DURABILITY_QOS;
+    signalWriterQos.history().kind = KEEP_LAST_HISTORY_QOS;
+    signalWriterQos.history().depth = 1;
+
+    ChatListener chat_listener;
+    SignalListener signal_listener;
+
+    DataReader* chat_reader = subscriber->create_datareader(sub_chat_topic, chatReaderQos, &chat_listener);
+    DataReader* signal_reader = subscriber->create_datareader(sub_signal_topic, signalReaderQos, &signal_listener);
+    DataWriter* chat_writer = publisher->create_datawriter(pub_chat_topic, chatWriterQos, nullptr);
+    DataWriter* signal_writer = publisher->create_datawriter(pub_signal_topic, signalWriterQos, nullptr);
+
+    if (chat_reader == nullptr || signal_reader == nullptr || chat_writer == nullptr || signal_writer == nullptr) {
+        std::cerr << "Error creating endpoints." << std::endl;
+        return 1;
+    }
+
+    while (chat_listener.matched.load() == 0 || signal_listener.matched.load() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::cout << "phase,typing_per_s,signals_sent,signals_received,chat_sent,chat_received,p50_us,p99_us,max_us" << std::endl;
+
+    runPhase("baseline", messages, 0, chat_writer, signal_writer, chat_listener, signal_listener);
+    runPhase("typing", messages, typing_per_s, chat_writer, signal_writer, chat_listener, signal_listener);
+
+    pub_participant->delete_contained_entities();
+    sub_participant->delete_contained_entities();
+    DomainParticipantFactory::get_instance()->delete_participant(pub_participant);
+    DomainParticipantFactory::get_instance()->delete_participant(sub_participant);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// SyncBench.cpp : Time and bytes to resync missed messages through the history sync topics.
+// Fills an outbox log, then asks for everything (a peer that missed it all) and for the last
+// 1000 messages (a short disconnect).
+//
+// Usage: SyncBench [messages] [message_bytes] [log_file]
+
+#include "ChatControlTypes.hpp"
+#include "HistorySync.hpp"
+#include "OutboxLog.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/LibrarySettings.hpp>
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+long long nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DomainParticipant* createParticipant(const std::string& name) {
+    DomainParticipantQos participantQos;
+    participantQos.name(name);
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+}
+
+std::atomic<bool> peer_ready(false);
+std::atomic<uint32_t> received(0);
+std::atomic<uint32_t> batches(0);
+std::atomic<unsigned long long> payload_bytes(0);
+
+// Requests everything after have and waits until it all arrived, prints one CSV row
+void runPhase(const std::string& phase, SyncRequester& requester, uint32_t have, uint32_t newest, size_t message_bytes) {
+    uint32_t missed = newest - have;
+
+    received = 0;
+    batches = 0;
+    payload_bytes = 0;
+
+    long long start = nowMicros();
+    requester.request(have);
+
+    while (received.load() < missed && nowMicros() - start < 300000000LL) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    double ms = (nowMicros() - start) / 1000.0;
+
+    std::cout << phase << "," << missed << "," << message_bytes << "," << received.load() << ","
+        << batches.load() << "," << payload_bytes.load() << "," << ms << ","
+        << (ms > 0 ? received.load() / ms * 1000.0 : 0) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    long messages = argc > 1 ? std::atol(argv[1]) : 100000;
+    size_t message_bytes = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : 64;
+    std::string log_file = argc > 3 ? argv[3] : "./sync_bench.outbox";
+
+    if (messages < 1000) {
+        std::cerr << "Usage: " << argv[0] << " [messages >= 1000] [message_bytes] [log_file]" << std::endl;
+        return 1;
+    }
+
+    OutboxLog::remove(log_file);
+
+    OutboxLog log;
+
+    if (!log.open(log_file)) {
+        std::cerr << "Could not create " << log_file << "." << std::endl;
+        return 1;
+    }
+
+    std::string message(message_bytes, 'x');
+
+    for (long i = 1; i <= messages; i++) {
+        log.append(static_cast<uint32_t>(i), message);
+    }
+
+    log.flush();
+
+    // Both ends live in this process, make sure samples still go through a transport
+    eprosima::fastdds::LibrarySettings library_settings;
+    library_settings.intraprocess_delivery = eprosima::fastdds::IntraprocessDeliveryType::INTRAPROCESS_OFF;
+    DomainParticipantFactory::get_instance()->set_library_settings(library_settings);
+
+    DomainParticipant* sender = createParticipant("bench_sender");
+    DomainParticipant* receiver = createParticipant("bench_receiver");
+
+    if (sender == nullptr || receiver == nullptr) {
+        std::cerr << "Error creating participants." << std::endl;
+        return 1;
+    }
+
+    registerControlTypes(sender);
+    registerControlTypes(receiver);
+
+    {
+        SyncReplier replier("bench_a_b", "bench", &log);
+        SyncRequester requester("bench_a_b",
+            []() { peer_ready = true; },
+            [](uint32_t, uint32_t, const std::string&, const std::vector<std::string>& batch) {
+                batches++;
+                received += static_cast<uint32_t>(batch.size());
+
+                for (size_t i = 0; i < batch.size(); i++) {
+                    payload_bytes += batch[i].size();
+                }
+            });
+
+        if (!replier.init(sender) || !requester.init(receiver)) {
+            std::cerr << "Error creating endpoints." << std::endl;
+            return 1;
+        }
+
+        while (!peer_ready.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::cout << "phase,missed,message_bytes,received,batches,payload_bytes,ms,msgs_per_s" << std::endl;
+
+        uint32_t newest = static_cast<uint32_t>(messages);
+
+        runPhase("full", requester, 0, newest, message_bytes);
+        runPhase("incremental", requester, newest - 1000, newest, message_bytes);
+    }
+
+    DomainParticipantFactory::get_instance()->delete_participant(sender);
+    DomainParticipantFactory::get_instance()->delete_participant(receiver);
+    OutboxLog::remove(log_file);
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+// TransportBench.cpp : Throughput and per-message latency of the chat topic over TCP on loopback,
+// with one of the builtin QoS profiles. Run it through netem_bench.sh to add delay and loss.
+//
+// Usage: TransportBench <default|low-latency|bulk|wan> [messages] [message_bytes]
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "QosProfiles.hpp"
+#include "TransportProfile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastdds/LibrarySettings.hpp>
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/DataWriterListener.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+const uint16_t BENCH_TCP_PORT = 5199;
+
+long long nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LatencyListener : public DataReaderListener {
+public:
+    std::mutex mtx;
+    std::vector<long long> latencies;
+    std::atomic<int> received;
+    std::atomic<int> matched;
+    long long last_receive;
+    UserChat sample;
+
+    LatencyListener() : received(0), matched(0), last_receive(0) {}
+
+    void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override {
+        matched = info.current_count;
+    }
+
+    void on_data_available(DataReader* reader) override {
+        SampleInfo info;
+
+        while (reader->take_next_sample(&sample, &info) == RETCODE_OK) {
+            if (!info.valid_data) continue;
+
+            long long now = nowMicros();
+            long long sent = std::strtoll(sample.message().c_str(), nullptr, 10);
+
+            std::lock_guard<std::mutex> lock(mtx);
+            latencies.push_back(now - sent);
+            last_receive = now;
+            received++;
+        }
+    }
+};
+
+DomainParticipant* createParticipant(ChatConfig& config, bool listen) {
+    DomainParticipantQos participantQos;
+    participantQos.name(listen ? "bench_listener" : "bench_connector");
+
+    config.tcp_port = listen ? BENCH_TCP_PORT : 0;
+    applyTransport(participantQos, config);
+
+    if (!listen) {
+        participantQos.wire_protocol().builtin.initialPeersList.push_back(makeLocator("127.0.0.1", BENCH_TCP_PORT, config));
+    }
+
+    return DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || findQosProfile(argv[1]) == nullptr) {
+        std::cerr << "Usage: " << argv[0] << " <default|low-latency|bulk|wan> [messages] [message_bytes]" << std::endl;
+        return 1;
+    }
+
+    int messages = argc > 2 ? std::atoi(argv[2]) : 10000;
+    size_t message_bytes = argc > 3 ? static_cast<size_t>(std::atoi(argv[3])) : 256;
+
+    ChatConfig config;
+    config.use_tcp = true;
+    config.qos_profile = argv[1];
+
+    // Both ends live in this process, make sure samples still go through TCP
+    eprosima::fastdds::LibrarySettings library_settings;
+    library_settings.intraprocess_delivery = eprosima::fastdds::IntraprocessDeliveryType::INTRAPROCESS_OFF;
+    DomainParticipantFactory::get_instance()->set_library_settings(library_settings);
+
+    DomainParticipant* sub_participant = createParticipant(config, true);
+    DomainParticipant* pub_participant = createParticipant(config, false);
+
+    if (sub_participant == nullptr || pub_participant == nullptr) {
+        std::cerr << "Error creating participants." << std::endl;
+        return 1;
+    }
+
+    TypeSupport type(new UserChatPubSubType());
+    type.register_type(sub_participant);
+    type.register_type(pub_participant);
+
+    Topic* sub_topic = sub_participant->create_topic("bench_chat", "UserChat", TOPIC_QOS_DEFAULT);
+    Topic* pub_topic = pub_participant->create_topic("bench_chat", "UserChat", TOPIC_QOS_DEFAULT);
+
+    Subscriber* subscriber = sub_participant->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+    Publisher* publisher = pub_participant->create_publisher(PUBLISHER_QOS_DEFAULT, nullptr);
+
+    // Timings come from the profile, every message still has to arrive to be measured
+    DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+    applyQosProfile(readerQos, subscriber, config);
+    readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    readerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+
+    DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+    applyQosProfile(writerQos, publisher, config);
+    writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    writerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+    writerQos.reliability().max_blocking_time = msToDuration(60000);
+
+    LatencyListener listener;
+    DataReader* reader = subscriber->create_datareader(sub_topic, readerQos, &listener);
+    DataWriter* writer = publisher->create_datawriter(pub_topic, writerQos, nullptr);
+
+    if (reader == nullptr || writer == nullptr) {
+        std::cerr << "Error creating endpoints." << std::endl;
+        return 1;
+    }
+
+    while (listener.matched.load() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    UserChat sample;
+    sample.username("bench");
+
+    long long start = nowMicros();
+
+    for (int i = 0; i < messages; i++) {
+        std::string message = std::to_string(nowMicros()) + " ";
+        message.resize(std::max(message.size(), message_bytes), 'x');
+
+        sample.index(static_cast<uint32_t>(i + 1));
+        sample.message(message);
+        writer->write(&sample);
+    }
+
+    writer->wait_for_acknowledgments(msToDuration(60000));
+
+    while (listener.received.load() < messages && nowMicros() - start < 120000000LL) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::lock_guard<std::mutex> lock(listener.mtx);
+    std::vector<long long>& latencies = listener.latencies;
+    std::sort(latencies.begin(), latencies.end());
+
+    double seconds = (listener.last_receive - start) / 1000000.0;
+    size_t count = latencies.size();
+
+    std::cout << "profile,messages,bytes,received,msgs_per_s,MB_per_s,p50_us,p99_us,max_us" << std::endl;
+    std::cout << argv[1] << "," << messages << "," << message_bytes << "," << count << ","
+        << (seconds > 0 ? count / seconds : 0) << ","
+        << (seconds > 0 ? count * message_bytes / seconds / 1000000.0 : 0) << ","
+        << (count ? latencies[count / 2] : 0) << ","
+        << (count ? latencies[count * 99 / 100] : 0) << ","
+        << (count ? latencies[count - 1] : 0) << std::endl;
+
+    publisher->delete_datawriter(writer);
+    subscriber->delete_datareader(reader);
+    pub_participant->delete_contained_entities();
+    sub_participant->delete_contained_entities();
+    DomainParticipantFactory::get_instance()->delete_participant(pub_participant);
+    DomainParticipantFactory::get_instance()->delete_participant(sub_participant);
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Starts RECEIVERS AnnounceBench receivers and one sender on this machine and prints, for every
+# announcement, how many receivers got it and how long after the write the first and the last one did.
+# Shared memory is turned off so everything goes through UDP (multicast unless "--announce-group off").
+# Usage: ./announce_spread.sh [path/to/AnnounceBench] [receivers] [announcements] [--key value...]
+
+BENCH=${1:-./AnnounceBench}
+RECEIVERS=${2:-100}
+COUNT=${3:-20}
+if [ $# -ge 3 ]; then shift 3; else shift $#; fi
+
+export FASTDDS_BUILTIN_TRANSPORTS=UDPv4
+DIR=$(mktemp -d)
+
+i=0
+while [ "$i" -lt "$RECEIVERS" ]; do
+    "$BENCH" receive "$COUNT" "$@" > "$DIR/receive_$i.csv" &
+    i=$((i + 1))
+done
+
+"$BENCH" send "$RECEIVERS" "$COUNT" 100 "$@" > "$DIR/send.csv"
+wait
+
+# send.csv: index,send_us,write_us   receive_*.csv: index,receive_us
+cat "$DIR"/receive_*.csv | awk -F, -v receivers="$RECEIVERS" '
+    NR == FNR { if (FNR > 1) { sent[$1] = $2; write_us[$1] = $3 } next }
+    {
+        latency = $2 - sent[$1]
+        if (!($1 in first) || latency < first[$1]) first[$1] = latency
+        if (!($1 in last) || latency > last[$1]) last[$1] = latency
+        got[$1]++
+    }
+    END {
+        print "index,received,write_us,first_us,last_us,spread_us"
+        for (i = 1; i in sent; i++) {
+            print i "," got[i] + 0 "/" receivers "," write_us[i] "," first[i] "," last[i] "," last[i] - first[i]
+        }
+    }' "$DIR/send.csv" -
+
+rm -r "$DIR"
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Runs DiscoveryBench in both modes while tcpdump counts the RTPS packets it sends.
+# Needs root (or CAP_NET_RAW) for tcpdump. Usage: ./discovery_packets.sh [path/to/DiscoveryBench] [max_participants]
+#
+# Captures on every interface, since SPDP multicast leaves through the default multicast
+# interface rather than lo, and only outgoing packets so looped back copies count once.
+
+BENCH=${1:-./DiscoveryBench}
+MAX=${2:-80}
+
+# The bench already sets this up in code, this keeps any XML profile from adding shared memory
+export FASTDDS_BUILTIN_TRANSPORTS=UDPv4
+
+for MODE in simple server; do
+    tcpdump -i any -Q out -q -n "udp and (portrange 7400-7999 or port 11911)" -w "discovery_$MODE.pcap" 2>/dev/null &
+    DUMP=$!
+    sleep 1
+
+    "$BENCH" "$MODE" "$MAX"
+
+    sleep 1
+    kill "$DUMP"
+    wait "$DUMP" 2>/dev/null
+
+    echo "$MODE: $(tcpdump -r "discovery_$MODE.pcap" 2>/dev/null | wc -l) packets"
+done
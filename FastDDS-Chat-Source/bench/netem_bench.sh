@@ -0,0 +1,16 @@
+#!/bin/sh
+# Runs TransportBench with each builtin QoS profile while tc netem adds delay and loss on loopback.
+# Needs root for tc. Usage: ./netem_bench.sh [path/to/TransportBench] [delay_ms] [loss_percent]
+
+BENCH=${1:-./TransportBench}
+DELAY=${2:-50}
+LOSS=${3:-2}
+
+tc qdisc add dev lo root netem delay "${DELAY}ms" loss "${LOSS}%" || exit 1
+trap 'tc qdisc del dev lo root' EXIT
+
+echo "netem: ${DELAY}ms delay, ${LOSS}% loss"
+
+for PROFILE in default low-latency bulk wan; do
+    "$BENCH" "$PROFILE" 5000 256
+done
@@ -0,0 +1,253 @@
+/**
+ * @file AnnouncementChannel.hpp
+ */
+
+#ifndef ANNOUNCEMENTCHANNEL_H
+#define ANNOUNCEMENTCHANNEL_H
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "ChatParticipant.hpp"
+#include "ConsoleWriter.hpp"
+#include "QosProfiles.hpp"
+#include "TransportProfile.hpp"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/DataWriterListener.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// How long an announcement is still handed to users who come online after it was sent
+const unsigned int ANNOUNCEMENT_LIFESPAN_MS = 5 * 60 * 1000;
+
+// Announcements kept by the writer for readers that missed them
+const int32_t ANNOUNCEMENT_DEPTH = 16;
+
+// One topic everybody reads, for messages to the whole organisation. Every reader listens on
+// the same multicast group, so the writer sends each announcement once however many readers
+// there are, and only the readers that lost it ask for it again. Positive ACKs are turned off,
+// so thousands of readers don't all answer every heartbeat either.
+// The writer is only created by the first announce(), so readers don't match one writer per user.
+class AnnouncementChannel {
+private:
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Subscriber* subscriber_;
+    Topic* topic_;
+    DataWriter* writer_;
+    DataReader* reader_;
+
+    std::string username;
+    std::mutex mtx;         // Creating the writer
+    std::atomic<int> readers;
+
+    // Shows announcements from anyone else, unless a handler was set
+    std::function<void(const UserChat&)> handler;
+
+    class AnnouncementListener : public DataReaderListener, public DataWriterListener
+    {
+    private:
+        AnnouncementChannel* channel_;
+        UserChat sample_;
+    public:
+        AnnouncementListener(AnnouncementChannel* channel) : channel_(channel) {}
+        ~AnnouncementListener() override {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&sample_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (!info.valid_data) continue;
+
+                if (channel_->handler) {
+                    channel_->handler(sample_);
+                }
+                else if (sample_.username() != channel_->username) {
+                    ConsoleWriter::get().writeLine("[Announcement from " + sample_.username() + "] " + sample_.message());
+                }
+            }
+        }
+
+        void on_publication_matched(DataWriter*, const PublicationMatchedStatus& info) override
+        {
+            channel_->readers = info.current_count;
+        }
+    } listener_;
+
+    AnnouncementChannel()
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , subscriber_(nullptr)
+        , topic_(nullptr)
+        , writer_(nullptr)
+        , reader_(nullptr)
+        , readers(0)
+        , listener_(this)
+    {}
+
+    bool createWriter() {
+        // Everyone in the domain, whatever room they're in
+        publisher_ = participant_->create_publisher(PUBLISHER_QOS_DEFAULT, nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        writerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+        writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        writerQos.history().depth = ANNOUNCEMENT_DEPTH;
+        writerQos.lifespan().duration = msToDuration(ANNOUNCEMENT_LIFESPAN_MS);
+        writerQos.reliable_writer_qos().times.heartbeat_period = msToDuration(500);
+        writerQos.reliable_writer_qos().disable_positive_acks.enabled = true;
+        writerQos.reliable_writer_qos().disable_positive_acks.duration = msToDuration(5000);
+
+        writer_ = publisher_->create_datawriter(topic_, writerQos, &listener_);
+
+        return writer_ != nullptr;
+    }
+
+public:
+    AnnouncementChannel(const AnnouncementChannel&) = delete;
+    AnnouncementChannel& operator=(const AnnouncementChannel&) = delete;
+
+    ~AnnouncementChannel() {
+        shutdown();
+    }
+
+    static AnnouncementChannel& get() {
+        static AnnouncementChannel channel;
+        return channel;
+    }
+
+    // Set before init() to get every announcement (own ones too) instead of having them printed
+    void setHandler(const std::function<void(const UserChat&)>& handler) {
+        this->handler = handler;
+    }
+
+    // Starts listening for announcements
+    bool init(const std::string& username)
+    {
+        this->username = username;
+
+        // Everyone reads the topic in domain_id, whichever shard their room is on
+        participant_ = ChatParticipant::acquireBase();
+
+        if (participant_ == nullptr)
+        {
+            return false;
+        }
+
+        topic_ = participant_->create_topic("ChatAnnouncements", "UserChat", TOPIC_QOS_DEFAULT);
+
+        if (topic_ == nullptr)
+        {
+            return false;
+        }
+
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        readerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = ANNOUNCEMENT_DEPTH;
+        readerQos.lifespan().duration = msToDuration(ANNOUNCEMENT_LIFESPAN_MS);
+        readerQos.reliable_reader_qos().disable_positive_ACKs.enabled = true;
+
+        // Multicast only works over UDP, TCP users get their own copy
+        const ChatConfig& config = chatConfig();
+
+        if (!config.use_tcp && !config.announce_group_ip.empty()) {
+            uint16_t port = config.announce_group_port != 0 ? config.announce_group_port : udpMulticastPort(config.domain_id);
+            readerQos.endpoint().multicast_locator_list.push_back(makeLocator(config.announce_group_ip, port, config));
+        }
+
+        subscriber_ = participant_->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(topic_, readerQos, &listener_);
+
+        if (reader_ == nullptr)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // One write reaches every reader. Returns false if the writer couldn't be created or the write failed.
+    bool announce(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (participant_ == nullptr) return false;
+
+        if (writer_ == nullptr && !createWriter()) return false;
+
+        UserChat announcement;
+        announcement.username(username);
+        announcement.message(text);
+
+        return writer_->write(&announcement) == eprosima::fastdds::dds::RETCODE_OK;
+    }
+
+    // Readers matched by this user's writer, 0 before the first announce()
+    int readerCount() const {
+        return readers.load();
+    }
+
+    void shutdown() {
+        if (participant_ == nullptr) return;
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+        }
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (topic_ != nullptr)
+        {
+            participant_->delete_topic(topic_);
+        }
+
+        writer_ = nullptr;
+        publisher_ = nullptr;
+        reader_ = nullptr;
+        subscriber_ = nullptr;
+        topic_ = nullptr;
+        participant_ = nullptr;
+        readers = 0;
+
+        ChatParticipant::releaseBase();
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * @file CaptureFile.hpp
+ */
+
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Recorded UserChat traffic, written by ChatRecord and played back by ChatReplay.
+// The file starts with CAPTURE_MAGIC, then one record after another:
+//   topic:  [1][id][name length][name]
+//   sample: [2 or 3][topic id][us since the previous sample][index][picture][username length][username][message length][message]
+// Numbers are LEB128 varints (picture zigzagged), so a typical sample costs a few bytes plus its text.
+// Kind 2 leaves the username out, it's the same as the last sample on that topic.
+
+const char CAPTURE_MAGIC[8] = { 'F', 'D', 'D', 'S', 'C', 'A', 'P', '1' };
+
+enum CaptureRecordKind {
+    CAPTURE_TOPIC = 1,
+    CAPTURE_SAMPLE = 2,
+    CAPTURE_SAMPLE_USER = 3,
+};
+
+struct CaptureSample {
+    std::string topic;
+    uint64_t time_us;       // Since the first sample in the capture
+    uint32_t index;
+    int32_t picture;
+    std::string username;
+    std::string message;
+};
+
+class CaptureWriter {
+private:
+    std::mutex mtx;
+    std::ofstream file;
+    std::vector<std::string> last_user;     // By topic id
+    uint64_t last_time_us;
+    uint64_t samples;
+    std::string buffer;
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void putString(const std::string& str) {
+        putVarint(str.size());
+        buffer += str;
+    }
+
+public:
+    CaptureWriter() : last_time_us(0), samples(0) {}
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // Replaces anything already in filename
+    bool open(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        return static_cast<bool>(file);
+    }
+
+    // Returns the id to pass to write()
+    uint32_t addTopic(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint32_t id = static_cast<uint32_t>(last_user.size());
+
+        buffer.clear();
+        buffer.push_back(static_cast<char>(CAPTURE_TOPIC));
+        putVarint(id);
+        putString(name);
+        file.write(buffer.data(), buffer.size());
+
+        last_user.push_back("");
+        return id;
+    }
+
+    // time_us only has to be from a steady clock, the capture stores differences. Safe from any thread.
+    void write(uint32_t topic, uint64_t time_us, uint32_t index, int32_t picture,
+        const std::string& username, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (topic >= last_user.size()) return;
+
+        uint64_t delta = samples == 0 || time_us < last_time_us ? 0 : time_us - last_time_us;
+        bool new_user = samples == 0 || last_user[topic] != username;
+
+        buffer.clear();
+        buffer.push_back(static_cast<char>(new_user ? CAPTURE_SAMPLE_USER : CAPTURE_SAMPLE));
+        putVarint(topic);
+        putVarint(delta);
+        putVarint(index);
+        putVarint((static_cast<uint32_t>(picture) << 1) ^ static_cast<uint32_t>(picture >> 31));
+        if (new_user) putString(username);
+        putString(message);
+
+        file.write(buffer.data(), buffer.size());
+
+        if (new_user) last_user[topic] = username;
+        last_time_us = time_us;
+        samples++;
+    }
+
+    uint64_t sampleCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return samples;
+    }
+
+    bool close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        file.close();
+        return !file.fail();
+    }
+};
+
+class CaptureReader {
+private:
+    std::ifstream file;
+    std::vector<std::string> topics;
+    std::vector<std::string> last_user;
+    uint64_t time_us;
+
+    bool getVarint(uint64_t& value) {
+        value = 0;
+
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = file.get();
+            if (byte == EOF) return false;
+
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+
+        return false;
+    }
+
+    bool getString(std::string& str) {
+        uint64_t length = 0;
+        if (!getVarint(length) || length > 0xffffffffULL) return false;
+
+        str.resize(static_cast<size_t>(length));
+        return length == 0 || static_cast<bool>(file.read(&str[0], static_cast<std::streamsize>(length)));
+    }
+
+public:
+    CaptureReader() : time_us(0) {}
+
+    bool open(const std::string& filename) {
+        char magic[sizeof(CAPTURE_MAGIC)];
+
+        file.open(filename, std::ios::in | std::ios::binary);
+        if (!file.read(magic, sizeof(magic))) return false;
+
+        return std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) == 0;
+    }
+
+    // Reads the next sample, returns false at the end of the capture or at a cut off record
+    bool next(CaptureSample& sample) {
+        while (true) {
+            int kind = file.get();
+            uint64_t id = 0;
+
+            if (kind == EOF || !getVarint(id)) return false;
+
+            if (kind == CAPTURE_TOPIC) {
+                std::string name;
+                if (!getString(name)) return false;
+
+                topics.resize(static_cast<size_t>(id) + 1);
+                last_user.resize(topics.size());
+                topics[id] = name;
+                continue;
+            }
+
+            if ((kind != CAPTURE_SAMPLE && kind != CAPTURE_SAMPLE_USER) || id >= topics.size()) return false;
+
+            uint64_t delta = 0, index = 0, picture = 0;
+            if (!getVarint(delta) || !getVarint(index) || !getVarint(picture)) return false;
+
+            if (kind == CAPTURE_SAMPLE_USER && !getString(last_user[id])) return false;
+            if (!getString(sample.message)) return false;
+
+            time_us += delta;
+
+            uint32_t zigzag = static_cast<uint32_t>(picture);
+            sample.topic = topics[id];
+            sample.time_us = time_us;
+            sample.index = static_cast<uint32_t>(index);
+            sample.picture = static_cast<int32_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+            sample.username = last_user[id];
+            return true;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,388 @@
+/**
+ * @file ChatConfig.hpp
+ */
+
+#ifndef CHATCONFIG_H
+#define CHATCONFIG_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Default port used by Fast DDS Discovery Servers
+const uint16_t DEFAULT_DISCOVERY_SERVER_PORT = 11811;
+
+// How long a user can go silent before the roster shows them offline
+const unsigned int DEFAULT_PRESENCE_LEASE_MS = 1000;
+
+// Port TCP peers listen on when ip_list.txt doesn't say
+const uint16_t DEFAULT_TCP_PORT = 5100;
+
+// Group announcements are sent to, see AnnouncementChannel.hpp
+const std::string DEFAULT_ANNOUNCE_GROUP = "239.255.0.1";
+
+// Memory all conversations' histories share before older messages go to disk
+const unsigned int DEFAULT_HISTORY_MEMORY_KB = 8192;
+
+// Unacknowledged messages a contact can have in flight before sends report the queue as full
+const int32_t DEFAULT_SEND_QUEUE = 256;
+
+// Read on startup if it exists, command line options override it
+const std::string DEFAULT_CONFIG_FILE = "./chat_config.txt";
+
+// Settings that are picked when the program starts
+struct ChatConfig {
+    uint32_t domain_id;
+    uint16_t peer_port;                 // Port of peers in ip_list.txt without ":port", 0 to work it out
+    std::string discovery_server_ip;    // Empty means simple (multicast) discovery
+    uint16_t discovery_server_port;
+    unsigned int presence_lease_ms;     // Liveliness lease of the presence topic
+    bool use_tcp;                       // TCPv4 instead of the builtin UDP transport
+    uint16_t tcp_port;                  // TCP listening port, 0 to only connect out
+    std::string wan_address;            // Public address when listening behind NAT
+    std::string qos_profile;            // Writer/reader profile, see QosProfiles.hpp
+    std::string xml_profiles_file;      // Fast DDS XML profiles, loaded before anything is created
+    int32_t send_queue;                 // Unacknowledged messages kept per contact, 0 keeps the profile's history (overwrites)
+    unsigned int history_memory_kb;     // All conversations together, see ChatHistory.hpp
+    std::string serializer;             // "generated" or "fast" (UserChatFastType.hpp)
+    std::string data_representation;    // "xcdr1", "xcdr2" or empty for the Fast DDS default
+    std::string contact_startup;        // Restored contacts start "parallel" on BlockingTasks, or "lazy" when first opened
+    int split_panes;                    // Chats shown at once in the split view
+    std::string partition;              // Rooms/teams, comma separated. Empty is the default partition.
+    unsigned int partition_shards;      // Domains the first partition is hashed over, from domain_id up
+    std::string announce_group_ip;      // Multicast group of the announcement channel, empty sends unicast
+    uint16_t announce_group_port;       // 0 is the domain's Fast DDS user multicast port
+    unsigned int flow_limit_kbps;       // KB/s async writers may send together, 0 for no limit
+
+    ChatConfig()
+        : domain_id(0)
+        , peer_port(0)
+        , discovery_server_ip("")
+        , discovery_server_port(DEFAULT_DISCOVERY_SERVER_PORT)
+        , presence_lease_ms(DEFAULT_PRESENCE_LEASE_MS)
+        , use_tcp(false)
+        , tcp_port(0)
+        , wan_address("")
+        , qos_profile("default")
+        , xml_profiles_file("")
+        , send_queue(DEFAULT_SEND_QUEUE)
+        , history_memory_kb(DEFAULT_HISTORY_MEMORY_KB)
+        , serializer("generated")
+        , data_representation("")
+        , contact_startup("parallel")
+        , split_panes(2)
+        , partition("")
+        , partition_shards(1)
+        , announce_group_ip(DEFAULT_ANNOUNCE_GROUP)
+        , announce_group_port(0)
+        , flow_limit_kbps(0)
+    {}
+
+    bool useDiscoveryServer() const {
+        return !discovery_server_ip.empty();
+    }
+};
+
+inline ChatConfig& chatConfig() {
+    static ChatConfig config;
+    return config;
+}
+
+// Names in "partition", spaces around the commas are dropped
+inline std::vector<std::string> chatPartitions(const ChatConfig& config) {
+    std::vector<std::string> names;
+    size_t start = 0;
+
+    while (start <= config.partition.size()) {
+        size_t comma = config.partition.find(',', start);
+        if (comma == std::string::npos) comma = config.partition.size();
+
+        std::string name = config.partition.substr(start, comma - start);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+
+        if (!name.empty()) names.push_back(name);
+        start = comma + 1;
+    }
+
+    return names;
+}
+
+// Domain the participant joins. With partition_shards above 1 the first partition picks one of
+// the domains from domain_id up (FNV-1a, so every user in that room lands on the same one) and
+// discovery traffic stays inside the shard instead of reaching every participant.
+inline uint32_t chatDomainId(const ChatConfig& config) {
+    std::vector<std::string> names = chatPartitions(config);
+    if (config.partition_shards <= 1 || names.empty()) return config.domain_id;
+
+    uint32_t hash = 2166136261u;
+
+    for (char ch : names[0]) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 16777619u;
+    }
+
+    return config.domain_id + hash % config.partition_shards;
+}
+
+// Splits "ip" or "ip:port", port is left alone if it isn't given. Returns false if the port is bad.
+inline bool parseAddress(const std::string& address, std::string& ip, uint16_t& port) {
+    size_t colon = address.find(':');
+
+    if (colon == std::string::npos) {
+        ip = address;
+        return !ip.empty();
+    }
+
+    ip = address.substr(0, colon);
+    long parsed = std::strtol(address.substr(colon + 1).c_str(), nullptr, 10);
+
+    if (ip.empty() || parsed <= 0 || parsed > 65535) return false;
+
+    port = static_cast<uint16_t>(parsed);
+    return true;
+}
+
+// Whole number between min and max, returns false if value is anything else
+inline bool parseNumber(const std::string& value, long min, long max, long& number) {
+    char* end = nullptr;
+    number = std::strtol(value.c_str(), &end, 10);
+
+    return !value.empty() && *end == '\0' && number >= min && number <= max;
+}
+
+// Sets one option by name. The same names work in chat_config.txt ("presence_lease = 500")
+// and on the command line ("--presence-lease 500"). Returns false (after printing why) on a bad option.
+inline bool applyOption(ChatConfig& config, std::string key, const std::string& value) {
+    long number = 0;
+
+    for (size_t i = 0; i < key.size(); i++) {
+        if (key[i] == '-') key[i] = '_';
+    }
+
+    if (key == "domain_id") {
+        if (!parseNumber(value, 0, 232, number)) {
+            std::cerr << "Domain id should be between 0 and 232." << std::endl;
+            return false;
+        }
+
+        config.domain_id = static_cast<uint32_t>(number);
+    }
+    else if (key == "peer_port") {
+        if (!parseNumber(value, 0, 65535, number)) {
+            std::cerr << "Invalid peer port: " << value << std::endl;
+            return false;
+        }
+
+        config.peer_port = static_cast<uint16_t>(number);
+    }
+    else if (key == "discovery_server") {
+        if (!parseAddress(value, config.discovery_server_ip, config.discovery_server_port)) {
+            std::cerr << "Invalid discovery server address: " << value << std::endl;
+            return false;
+        }
+    }
+    else if (key == "presence_lease") {
+        if (!parseNumber(value, 100, 3600000, number)) {
+            std::cerr << "Presence lease should be at least 100 ms." << std::endl;
+            return false;
+        }
+
+        config.presence_lease_ms = static_cast<unsigned int>(number);
+    }
+    else if (key == "tcp") {
+        if (!parseNumber(value, 0, 65535, number)) {
+            std::cerr << "Invalid TCP port: " << value << std::endl;
+            return false;
+        }
+
+        config.use_tcp = true;
+        config.tcp_port = static_cast<uint16_t>(number);
+    }
+    else if (key == "wan_address") {
+        config.wan_address = value;
+    }
+    else if (key == "qos_profile") {
+        config.qos_profile = value;
+    }
+    else if (key == "xml_profiles") {
+        config.xml_profiles_file = value;
+    }
+    else if (key == "send_queue") {
+        if (!parseNumber(value, 0, 100000, number)) {
+            std::cerr << "Send queue should be between 0 and 100000 messages." << std::endl;
+            return false;
+        }
+
+        config.send_queue = static_cast<int32_t>(number);
+    }
+    else if (key == "history_memory") {
+        if (!parseNumber(value, 16, 4194304, number)) {
+            std::cerr << "History memory should be between 16 and 4194304 KB." << std::endl;
+            return false;
+        }
+
+        config.history_memory_kb = static_cast<unsigned int>(number);
+    }
+    else if (key == "serializer") {
+        if (value != "generated" && value != "fast") {
+            std::cerr << "Serializer should be generated or fast." << std::endl;
+            return false;
+        }
+
+        config.serializer = value;
+    }
+    else if (key == "data_representation") {
+        if (value != "xcdr1" && value != "xcdr2") {
+            std::cerr << "Data representation should be xcdr1 or xcdr2." << std::endl;
+            return false;
+        }
+
+        config.data_representation = value;
+    }
+    else if (key == "contact_startup") {
+        if (value != "parallel" && value != "lazy") {
+            std::cerr << "Contact startup should be parallel or lazy." << std::endl;
+            return false;
+        }
+
+        config.contact_startup = value;
+    }
+    else if (key == "split_panes") {
+        if (!parseNumber(value, 1, 8, number)) {
+            std::cerr << "Split panes should be between 1 and 8." << std::endl;
+            return false;
+        }
+
+        config.split_panes = static_cast<int>(number);
+    }
+    else if (key == "partition") {
+        config.partition = value;
+    }
+    else if (key == "partition_shards") {
+        if (!parseNumber(value, 1, 233, number)) {
+            std::cerr << "Partition shards should be between 1 and 233." << std::endl;
+            return false;
+        }
+
+        config.partition_shards = static_cast<unsigned int>(number);
+    }
+    else if (key == "flow_limit") {
+        if (!parseNumber(value, 0, 10000000, number)) {
+            std::cerr << "Flow limit should be between 0 and 10000000 KB/s." << std::endl;
+            return false;
+        }
+
+        config.flow_limit_kbps = static_cast<unsigned int>(number);
+    }
+    else if (key == "announce_group") {
+        if (value == "off") {
+            config.announce_group_ip = "";
+            return true;
+        }
+
+        long first_octet = std::strtol(value.c_str(), nullptr, 10);
+        config.announce_group_port = 0;
+
+        if (!parseAddress(value, config.announce_group_ip, config.announce_group_port) || first_octet < 224 || first_octet > 239) {
+            std::cerr << "Announce group should be a multicast address (224.0.0.0 - 239.255.255.255) with an optional :port, or off." << std::endl;
+            return false;
+        }
+    }
+    else {
+        std::cerr << "Unknown option: " << key << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Reads "key = value" lines, '#' starts a comment. A missing file is only an error if it was asked for.
+inline bool loadConfigFile(ChatConfig& config, const std::string& filename, bool required) {
+    std::ifstream inputFile(filename);
+
+    if (!inputFile) {
+        if (required) std::cerr << "Could not open config file " << filename << "." << std::endl;
+        return !required;
+    }
+
+    std::string line;
+
+    while (std::getline(inputFile, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) continue;
+
+        std::string key = line.substr(0, equals);
+        std::string value = line.substr(equals + 1);
+
+        key.erase(0, key.find_first_not_of(" \t\r"));
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t\r"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+
+        if (key.empty()) continue;
+
+        if (!applyOption(config, key, value)) {
+            std::cerr << "(in " << filename << ")" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Reads chat_config.txt (or the file given with --config) into chatConfig(), then the
+// command line on top of it. Returns false (after printing usage) on a bad option.
+inline bool parseArgs(int argc, char** argv) {
+    ChatConfig& config = chatConfig();
+    std::string config_file = DEFAULT_CONFIG_FILE;
+    bool required = false;
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--config") {
+            config_file = argv[i + 1];
+            required = true;
+        }
+    }
+
+    if (!loadConfigFile(config, config_file, required)) return false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--config" && i + 1 < argc) {
+            i++;
+        }
+        else if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            if (!applyOption(config, arg.substr(2), argv[++i])) return false;
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--config <file>] [--domain-id <id>] [--peer-port <port>]"
+                << " [--discovery-server <ip[:port]>] [--presence-lease <ms>]"
+                << " [--tcp <listen_port|0>] [--wan-address <ip>]"
+                << " [--qos-profile <default|low-latency|bulk|wan|xml profile>] [--xml-profiles <file>]"
+                << " [--send-queue <messages>] [--history-memory <KB>]"
+                << " [--serializer <generated|fast>] [--data-representation <xcdr1|xcdr2>]"
+                << " [--contact-startup <parallel|lazy>] [--split-panes <1-8>]"
+                << " [--partition <room[,room...]>] [--partition-shards <domains>]"
+                << " [--announce-group <ip[:port]|off>] [--flow-limit <KB/s>]" << std::endl;
+            return false;
+        }
+    }
+
+    if (config.domain_id + config.partition_shards - 1 > 232) {
+        std::cerr << "Domain " << config.domain_id << " with " << config.partition_shards << " partition shards goes past domain 232." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,329 @@
+/**
+ * @file ChatControlTypes.hpp
+ */
+
+#ifndef CHATCONTROLTYPES_H
+#define CHATCONTROLTYPES_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/topic/TopicDataType.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+#include <fastdds/rtps/common/InstanceHandle.hpp>
+#include <fastdds/rtps/common/SerializedPayload.hpp>
+
+// Type support for the structs in ChatControl.idl. They are final structs of u32s, strings and
+// sequences of strings, always written little endian:
+//   XCDRv1 (PLAIN_CDR):   [00 01 00 00] then the fields
+//   XCDRv2 (PLAIN_CDR2):  [00 07 00 00] then the fields, a sequence of strings has a DHEADER (its length) first
+// Strings are a u32 length (counting the '\0'), the text and a '\0'; u32s are aligned to 4.
+
+// Encapsulation identifiers from the DDS-XTypes spec
+const uint16_t CONTROL_ENCAPSULATION_CDR_LE = 0x0001;
+const uint16_t CONTROL_ENCAPSULATION_CDR2_LE = 0x0007;
+
+class ControlCdrWriter {
+private:
+    unsigned char* out;     // nullptr only counts the bytes
+    size_t pos;
+    bool xcdr2;
+
+    void align4() {
+        size_t aligned = (pos + 3) & ~static_cast<size_t>(3);
+        if (out != nullptr) std::memset(out + pos, 0, aligned - pos);
+        pos = aligned;
+    }
+
+    void put(size_t at, uint32_t value) {
+        out[at] = static_cast<unsigned char>(value & 0xff);
+        out[at + 1] = static_cast<unsigned char>((value >> 8) & 0xff);
+        out[at + 2] = static_cast<unsigned char>((value >> 16) & 0xff);
+        out[at + 3] = static_cast<unsigned char>((value >> 24) & 0xff);
+    }
+
+public:
+    // out starts right after the encapsulation header, which is where CDR aligns from
+    ControlCdrWriter(unsigned char* out, bool xcdr2) : out(out), pos(0), xcdr2(xcdr2) {}
+
+    size_t size() const {
+        return pos;
+    }
+
+    void u32(uint32_t value) {
+        align4();
+        if (out != nullptr) put(pos, value);
+        pos += 4;
+    }
+
+    void string(const std::string& str) {
+        u32(static_cast<uint32_t>(str.size() + 1));
+
+        if (out != nullptr) {
+            std::memcpy(out + pos, str.data(), str.size());
+            out[pos + str.size()] = 0;
+        }
+
+        pos += str.size() + 1;
+    }
+
+    void strings(const std::vector<std::string>& list) {
+        size_t dheader = 0;
+
+        if (xcdr2) {
+            align4();
+            dheader = pos;
+            pos += 4;
+        }
+
+        u32(static_cast<uint32_t>(list.size()));
+        for (const std::string& str : list) string(str);
+
+        if (xcdr2 && out != nullptr) put(dheader, static_cast<uint32_t>(pos - dheader - 4));
+    }
+};
+
+class ControlCdrReader {
+private:
+    const unsigned char* in;
+    size_t pos;
+    size_t end;
+    bool xcdr2;
+
+    bool align4() {
+        pos = (pos + 3) & ~static_cast<size_t>(3);
+        return pos <= end;
+    }
+
+public:
+    ControlCdrReader(const eprosima::fastdds::rtps::SerializedPayload_t& payload)
+        : in(payload.data + 4)
+        , pos(0)
+        , end(payload.length >= 4 ? payload.length - 4 : 0)
+        , xcdr2(false)
+    {}
+
+    // Anything but the two encapsulations ControlCdrWriter makes is refused
+    bool begin() {
+        if (end == 0) return false;
+
+        uint16_t encapsulation = static_cast<uint16_t>((in[-4] << 8) | in[-3]);
+
+        if (encapsulation == CONTROL_ENCAPSULATION_CDR2_LE) xcdr2 = true;
+        else if (encapsulation != CONTROL_ENCAPSULATION_CDR_LE) return false;
+
+        return true;
+    }
+
+    bool u32(uint32_t& value) {
+        if (!align4() || end - pos < 4) return false;
+
+        const unsigned char* p = in + pos;
+        value = static_cast<uint32_t>(p[0])
+            | (static_cast<uint32_t>(p[1]) << 8)
+            | (static_cast<uint32_t>(p[2]) << 16)
+            | (static_cast<uint32_t>(p[3]) << 24);
+        pos += 4;
+        return true;
+    }
+
+    bool string(std::string& str) {
+        uint32_t length;
+        if (!u32(length) || length == 0 || length > end - pos) return false;
+
+        // The '\0' is counted in the length but isn't part of the string
+        str.assign(reinterpret_cast<const char*>(in + pos), length - 1);
+        pos += length;
+        return true;
+    }
+
+    bool strings(std::vector<std::string>& list) {
+        uint32_t length, count;
+
+        if (xcdr2 && (!u32(length) || length > end - pos)) return false;
+        if (!u32(count)) return false;
+
+        // Every string takes at least 5 bytes, so a bad count can't make this allocate much
+        if (count > (end - pos) / 5) return false;
+
+        list.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (!string(list[i])) return false;
+        }
+
+        return true;
+    }
+};
+
+// <topic>_sync_req, see HistorySync.hpp
+struct ChatSyncRequest {
+    static const char* typeName() { return "ChatSyncRequest"; }
+    static const uint32_t MAX_SERIALIZED_SIZE = 4 + 8;
+
+    uint32_t have;                      // Last index the requester has
+    uint32_t upto;                      // Last index wanted, 0 for all of them
+
+    ChatSyncRequest() : have(0), upto(0) {}
+
+    void serialize(ControlCdrWriter& cdr) const {
+        cdr.u32(have);
+        cdr.u32(upto);
+    }
+
+    bool deserialize(ControlCdrReader& cdr) {
+        return cdr.u32(have) && cdr.u32(upto);
+    }
+};
+
+// <topic>_sync_rep, see HistorySync.hpp. An empty reply means there is nothing to send.
+struct ChatSyncReply {
+    static const char* typeName() { return "ChatSyncReply"; }
+
+    // Only what the payload pool preallocates, bigger batches get a bigger payload
+    static const uint32_t MAX_SERIALIZED_SIZE = 4 + 16 * 1024;
+
+    uint32_t first;                     // Index of messages[0]
+    uint32_t last;                      // Last index of the whole range being sent
+    uint32_t count;                     // messages.size()
+    std::string sender;
+    std::vector<std::string> messages;
+
+    ChatSyncReply() : first(0), last(0), count(0) {}
+
+    void serialize(ControlCdrWriter& cdr) const {
+        cdr.u32(first);
+        cdr.u32(last);
+        cdr.u32(count);
+        cdr.string(sender);
+        cdr.strings(messages);
+    }
+
+    bool deserialize(ControlCdrReader& cdr) {
+        return cdr.u32(first) && cdr.u32(last) && cdr.u32(count) && cdr.string(sender)
+            && cdr.strings(messages) && count == messages.size();
+    }
+};
+
+// <topic>_ack, see DeliveryReceipts.hpp
+struct ChatReceipt {
+    static const char* typeName() { return "ChatReceipt"; }
+    static const uint32_t MAX_SERIALIZED_SIZE = 4 + 8;
+
+    uint32_t delivered;                 // Every message up to this index arrived
+    uint32_t read;                      // Every message up to this index was shown
+
+    ChatReceipt() : delivered(0), read(0) {}
+
+    void serialize(ControlCdrWriter& cdr) const {
+        cdr.u32(delivered);
+        cdr.u32(read);
+    }
+
+    bool deserialize(ControlCdrReader& cdr) {
+        return cdr.u32(delivered) && cdr.u32(read);
+    }
+};
+
+// Type support for one of the samples above. It has no TypeObject, so peers match on the
+// type name; only chat clients use these topics.
+template<class Sample>
+class ControlPubSubType : public eprosima::fastdds::dds::TopicDataType
+{
+public:
+    typedef Sample type;
+
+    ControlPubSubType()
+    {
+        set_name(Sample::typeName());
+        max_serialized_type_size = Sample::MAX_SERIALIZED_SIZE;
+        is_compute_key_provided = false;
+    }
+
+    ~ControlPubSubType() override {}
+
+    bool serialize(
+            const void* const data,
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            eprosima::fastdds::dds::DataRepresentationId_t data_representation) override
+    {
+        const Sample* sample = static_cast<const Sample*>(data);
+        bool xcdr2 = data_representation != eprosima::fastdds::dds::XCDR_DATA_REPRESENTATION;
+
+        ControlCdrWriter counter(nullptr, xcdr2);
+        sample->serialize(counter);
+        if (4 + counter.size() > payload.max_size) return false;
+
+        unsigned char* out = reinterpret_cast<unsigned char*>(payload.data) + 4;
+        uint16_t encapsulation = xcdr2 ? CONTROL_ENCAPSULATION_CDR2_LE : CONTROL_ENCAPSULATION_CDR_LE;
+        out[-4] = static_cast<unsigned char>(encapsulation >> 8);
+        out[-3] = static_cast<unsigned char>(encapsulation & 0xff);
+        out[-2] = 0;
+        out[-1] = 0;
+
+        ControlCdrWriter cdr(out, xcdr2);
+        sample->serialize(cdr);
+
+        payload.encapsulation = CDR_LE;
+        payload.length = static_cast<uint32_t>(4 + cdr.size());
+        return true;
+    }
+
+    bool deserialize(
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            void* data) override
+    {
+        ControlCdrReader cdr(payload);
+        return cdr.begin() && static_cast<Sample*>(data)->deserialize(cdr);
+    }
+
+    uint32_t calculate_serialized_size(
+            const void* const data,
+            eprosima::fastdds::dds::DataRepresentationId_t data_representation) override
+    {
+        ControlCdrWriter counter(nullptr, data_representation != eprosima::fastdds::dds::XCDR_DATA_REPRESENTATION);
+        static_cast<const Sample*>(data)->serialize(counter);
+        return static_cast<uint32_t>(4 + counter.size());
+    }
+
+    bool compute_key(
+            eprosima::fastdds::rtps::SerializedPayload_t&,
+            eprosima::fastdds::rtps::InstanceHandle_t&,
+            bool = false) override
+    {
+        return false;
+    }
+
+    bool compute_key(
+            const void* const,
+            eprosima::fastdds::rtps::InstanceHandle_t&,
+            bool = false) override
+    {
+        return false;
+    }
+
+    void* create_data() override
+    {
+        return reinterpret_cast<void*>(new Sample());
+    }
+
+    void delete_data(void* data) override
+    {
+        delete(reinterpret_cast<Sample*>(data));
+    }
+
+    void register_type_object_representation() override
+    {
+    }
+};
+
+// Registers every control type on a chat participant, next to UserChat
+inline void registerControlTypes(eprosima::fastdds::dds::DomainParticipant* participant) {
+    eprosima::fastdds::dds::TypeSupport(new ControlPubSubType<ChatSyncRequest>()).register_type(participant);
+    eprosima::fastdds::dds::TypeSupport(new ControlPubSubType<ChatSyncReply>()).register_type(participant);
+    eprosima::fastdds::dds::TypeSupport(new ControlPubSubType<ChatReceipt>()).register_type(participant);
+}
+
+#endif
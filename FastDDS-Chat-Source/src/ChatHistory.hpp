@@ -0,0 +1,352 @@
+/**
+ * @file ChatHistory.hpp
+ */
+
+#ifndef CHATHISTORY_H
+#define CHATHISTORY_H
+
+#include "ConsoleWriter.hpp"
+#include "ChatConfig.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+// Number of messages shown when a chat is opened or /more is typed
+const size_t SCROLLBACK_PAGE_SIZE = 20;
+
+// Every this many spilled messages the file offset is remembered, the rest are found by skipping forward
+const size_t SPILL_INDEX_STRIDE = 64;
+
+// Rough cost of one message in memory besides its text
+const size_t HISTORY_LINE_OVERHEAD = sizeof(std::string) + 16;
+
+// Once the budget is exceeded histories spill down to this much of it, so the next trim is a while off
+const size_t HISTORY_TRIM_PERCENT = 90;
+
+class ChatHistory;
+
+// chatConfig().history_memory_kb shared by every conversation, so the total stays capped however
+// many chats are open. Whichever conversations hold the most memory spill their oldest messages,
+// so an idle chat doesn't keep the budget while the active one is squeezed.
+class HistoryBudget {
+private:
+    std::mutex mtx;                     // Taken before a history's own lock, never after it
+    std::vector<ChatHistory*> histories;
+    std::atomic<size_t> used;
+    size_t limit;
+    size_t target;                      // What trim() spills down to
+
+    HistoryBudget()
+        : used(0)
+        , limit(static_cast<size_t>(chatConfig().history_memory_kb) * 1024)
+        , target(limit / 100 * HISTORY_TRIM_PERCENT)
+    {}
+
+public:
+    HistoryBudget(const HistoryBudget&) = delete;
+    HistoryBudget& operator=(const HistoryBudget&) = delete;
+
+    static HistoryBudget& get() {
+        static HistoryBudget budget;
+        return budget;
+    }
+
+    void add(ChatHistory* history) {
+        std::lock_guard<std::mutex> lock(mtx);
+        histories.push_back(history);
+    }
+
+    void remove(ChatHistory* history) {
+        std::lock_guard<std::mutex> lock(mtx);
+        histories.erase(std::remove(histories.begin(), histories.end(), history), histories.end());
+    }
+
+    void charge(size_t bytes) {
+        used += bytes;
+    }
+
+    void refund(size_t bytes) {
+        used -= bytes;
+    }
+
+    bool over() const {
+        return used.load() > limit;
+    }
+
+    bool aboveTarget() const {
+        return used.load() > target;
+    }
+
+    // Spills from the histories, largest first, until the total is down to the target. Called without any history's lock.
+    void trim();
+};
+
+// History of a single conversation, shared between the Publisher, Subscriber and main menu.
+// Only the newest messages stay in memory, within the HistoryBudget; older ones
+// are moved to a temporary spill file as [length u32][text] records and read back when
+// scrolling or searching reaches them. The spill file is deleted when the program exits.
+class ChatHistory {
+private:
+    std::deque<std::string> lines;      // Newest messages, lines[0] is message number spilled
+    size_t memory_bytes;                // What lines costs, roughly
+
+    std::FILE* spill_file;              // Opened the first time something is evicted
+    bool spill_failed;                  // No temporary file could be made, everything stays in memory
+    size_t spilled;                     // Messages in the spill file
+    uint64_t spill_end;
+    std::vector<uint64_t> spill_index;  // spill_index[i] is where message i * SPILL_INDEX_STRIDE starts
+
+    mutable std::mutex mtx;
+
+    static size_t lineCost(const std::string& line) {
+        return line.size() + HISTORY_LINE_OVERHEAD;
+    }
+
+    // fseek takes a long, which is 32 bits on Windows, so spill files past 2 GB need these
+    static int seekSpill(std::FILE* file, int64_t offset, int origin) {
+#ifdef _WIN32
+        return _fseeki64(file, offset, origin);
+#else
+        return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+    }
+
+    // Moves the oldest messages to the spill file until every history together is down to the budget's target
+    void evict() {
+        while (HistoryBudget::get().aboveTarget() && lines.size() > 1) {
+            if (spill_file == nullptr) {
+                if (spill_failed) return;
+
+                spill_file = std::tmpfile();
+
+                if (spill_file == nullptr) {
+                    spill_failed = true;
+                    return;
+                }
+            }
+
+            const std::string& line = lines.front();
+            unsigned char header[4];
+            uint32_t length = static_cast<uint32_t>(line.size());
+
+            header[0] = static_cast<unsigned char>(length & 0xff);
+            header[1] = static_cast<unsigned char>((length >> 8) & 0xff);
+            header[2] = static_cast<unsigned char>((length >> 16) & 0xff);
+            header[3] = static_cast<unsigned char>((length >> 24) & 0xff);
+
+            seekSpill(spill_file, static_cast<int64_t>(spill_end), SEEK_SET);
+
+            if (std::fwrite(header, 1, sizeof(header), spill_file) != sizeof(header)
+                || std::fwrite(line.data(), 1, line.size(), spill_file) != line.size()) {
+                // Disk full, keep the rest in memory rather than lose them
+                spill_failed = true;
+                return;
+            }
+
+            if (spilled % SPILL_INDEX_STRIDE == 0) spill_index.push_back(spill_end);
+
+            spill_end += sizeof(header) + line.size();
+            spilled++;
+            memory_bytes -= lineCost(line);
+            HistoryBudget::get().refund(lineCost(line));
+            lines.pop_front();
+        }
+    }
+
+    // Reads spilled messages [from, to) and hands each one to fn
+    void readSpilled(size_t from, size_t to, const std::function<void(const std::string&)>& fn) const {
+        if (from >= to) return;
+
+        seekSpill(spill_file, static_cast<int64_t>(spill_index[from / SPILL_INDEX_STRIDE]), SEEK_SET);
+
+        std::string line;
+        unsigned char header[4];
+
+        for (size_t i = from - from % SPILL_INDEX_STRIDE; i < to; i++) {
+            if (std::fread(header, 1, sizeof(header), spill_file) != sizeof(header)) return;
+
+            uint32_t length = static_cast<uint32_t>(header[0])
+                | (static_cast<uint32_t>(header[1]) << 8)
+                | (static_cast<uint32_t>(header[2]) << 16)
+                | (static_cast<uint32_t>(header[3]) << 24);
+
+            if (i < from) {
+                seekSpill(spill_file, static_cast<int64_t>(length), SEEK_CUR);
+                continue;
+            }
+
+            line.resize(length);
+            if (length > 0 && std::fread(&line[0], 1, length, spill_file) != length) return;
+
+            fn(line);
+        }
+    }
+
+    // Hands messages [from, to) to fn, from the spill file and then memory
+    void visit(size_t from, size_t to, const std::function<void(const std::string&)>& fn) const {
+        size_t total = spilled + lines.size();
+        if (to > total) to = total;
+
+        if (from < spilled) {
+            readSpilled(from, to < spilled ? to : spilled, fn);
+            from = spilled;
+        }
+
+        for (size_t i = from; i < to; i++) {
+            fn(lines[i - spilled]);
+        }
+    }
+
+public:
+    ChatHistory()
+        : memory_bytes(0)
+        , spill_file(nullptr)
+        , spill_failed(false)
+        , spilled(0)
+        , spill_end(0)
+    {
+        HistoryBudget::get().add(this);
+    }
+
+    ChatHistory(const ChatHistory&) = delete;
+    ChatHistory& operator=(const ChatHistory&) = delete;
+
+    ~ChatHistory() {
+        HistoryBudget::get().remove(this);
+        HistoryBudget::get().refund(memory_bytes);
+
+        if (spill_file != nullptr) std::fclose(spill_file);
+    }
+
+    void push_back(const std::string& line) {
+        CHAT_TRACE_SPAN("history_append");
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            lines.push_back(line);
+            memory_bytes += lineCost(line);
+            HistoryBudget::get().charge(lineCost(line));
+        }
+
+        if (HistoryBudget::get().over()) HistoryBudget::get().trim();
+    }
+
+    // What the messages kept in memory cost, roughly
+    size_t memoryBytes() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return memory_bytes;
+    }
+
+    // Spills this history's oldest messages while the budget is above its target
+    void spillOver() {
+        std::lock_guard<std::mutex> lock(mtx);
+        evict();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return spilled + lines.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Messages that were moved to disk
+    size_t spilledCount() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return spilled;
+    }
+
+    // Copy of the whole history. Reads back everything that was spilled, forEach() doesn't.
+    std::vector<std::string> snapshot() const {
+        std::vector<std::string> copy;
+        forEach([&copy](const std::string& line) { copy.push_back(line); });
+        return copy;
+    }
+
+    // Hands every message to fn, oldest first (used when saving chat logs). fn must not touch this history.
+    void forEach(const std::function<void(const std::string&)>& fn) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        visit(0, spilled + lines.size(), fn);
+    }
+
+    // Copies up to count messages that come right before cursor into page, returns the new cursor
+    size_t page(size_t cursor, size_t count, std::vector<std::string>& page) const {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        size_t total = spilled + lines.size();
+        if (cursor > total) cursor = total;
+        size_t start = cursor > count ? cursor - count : 0;
+
+        page.clear();
+        visit(start, cursor, [&page](const std::string& line) { page.push_back(line); });
+        return start;
+    }
+
+    // Copies up to max_results of the newest messages containing text into results, oldest first
+    size_t search(const std::string& text, size_t max_results, std::vector<std::string>& results) const {
+        std::deque<std::string> found;
+
+        forEach([&](const std::string& line) {
+            if (line.find(text) == std::string::npos) return;
+
+            found.push_back(line);
+            if (found.size() > max_results) found.pop_front();
+        });
+
+        results.assign(found.begin(), found.end());
+        return results.size();
+    }
+
+    // Prints the page before cursor, returns the cursor to continue scrolling back from
+    size_t printPage(size_t cursor, size_t count) const {
+        std::vector<std::string> temp_page;
+        size_t start = page(cursor, count, temp_page);
+
+        // Whole page goes out as one write
+        std::string out = "";
+
+        if (start > 0) {
+            out += "(" + std::to_string(start) + " older messages, type /more to see them)\n";
+        }
+
+        for (std::string& str : temp_page) {
+            out += str + "\n";
+        }
+
+        ConsoleWriter::get().write(out);
+
+        return start;
+    }
+};
+
+inline void HistoryBudget::trim() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<std::pair<size_t, ChatHistory*>> largest;
+
+    for (ChatHistory* history : histories) {
+        largest.push_back(std::make_pair(history->memoryBytes(), history));
+    }
+
+    std::sort(largest.begin(), largest.end(),
+        [](const std::pair<size_t, ChatHistory*>& a, const std::pair<size_t, ChatHistory*>& b) { return a.first > b.first; });
+
+    for (size_t i = 0; i < largest.size() && aboveTarget(); i++) {
+        largest[i].second->spillOver();
+    }
+}
+
+#endif
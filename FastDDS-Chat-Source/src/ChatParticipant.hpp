@@ -0,0 +1,203 @@
+/**
+ * @file ChatParticipant.hpp
+ */
+
+#ifndef CHATPARTICIPANT_H
+#define CHATPARTICIPANT_H
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "QosProfiles.hpp"
+#include "TransportProfile.hpp"
+#include "UserChatFastType.hpp"
+#include "NetStatsTypes.hpp"
+#include "ChatControlTypes.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// One DomainParticipant shared by every Publisher and Subscriber in the process.
+// A participant brings its own Fast DDS threads, so sharing it keeps the thread
+// count the same no matter how many users are added.
+// With partition_shards it is in the room's shard; what has to reach every shard
+// (announcements) gets a second participant in domain_id itself through acquireBase().
+class ChatParticipant {
+private:
+    DomainParticipant* participant_;
+    TypeSupport type_;
+    int users;
+    DomainParticipant* base_participant_;
+    TypeSupport base_type_;
+    int base_users;
+    std::mutex mtx;
+
+    ChatParticipant() : participant_(nullptr), users(0), base_participant_(nullptr), base_users(0) {}
+
+    static ChatParticipant& instance() {
+        static ChatParticipant chat_participant;
+        return chat_participant;
+    }
+
+    // Parse for IPs ("ip" or "ip:port"), an empty list means FastDDS works locally
+    static void addInitialPeers(DomainParticipantQos& participantQos, const ChatConfig& config, uint32_t domain_id) {
+        std::ifstream inputFile("./ip_list.txt");
+
+        if (!inputFile) {
+            std::cerr << "Could not open file!" << std::endl;
+            return;
+        }
+
+        std::string line;
+
+        // Skips first two lines
+        std::getline(inputFile, line);
+        std::getline(inputFile, line);
+
+        // Loops through IPs
+        while (std::getline(inputFile, line)) {
+            std::string ip;
+            uint16_t port = defaultPeerPort(config, domain_id);
+
+            if (!parseAddress(line, ip, port)) continue;
+
+            // Broadcast/multicast entries only make sense for UDP
+            if (config.use_tcp && (ip == "255.255.255.255" || ip.compare(0, 4, "239.") == 0 || ip.compare(0, 4, "224.") == 0)) continue;
+
+            participantQos.wire_protocol().builtin.initialPeersList.push_back(makeLocator(ip, port, config));
+        }
+
+        inputFile.close();
+    }
+
+    // Client of a Discovery Server, peers only talk to the server during discovery instead of to each other
+    static void addDiscoveryServer(DomainParticipantQos& participantQos, const ChatConfig& config) {
+        eprosima::fastdds::rtps::Locator_t server = makeLocator(config.discovery_server_ip, config.discovery_server_port, config);
+
+        participantQos.wire_protocol().builtin.discovery_config.discoveryProtocol = eprosima::fastdds::rtps::DiscoveryProtocol::CLIENT;
+        participantQos.wire_protocol().builtin.discovery_config.m_DiscoveryServers.push_back(server);
+    }
+
+    static DomainParticipant* create(uint32_t domain_id, const std::string& name, TypeSupport& type) {
+        if (!loadXmlProfiles(chatConfig())) {
+            return nullptr;
+        }
+
+        DomainParticipantQos participantQos;
+        applyQosProfile(participantQos, chatConfig());
+        participantQos.name(name);
+
+        applyTransport(participantQos, chatConfig());
+        addChatFlowController(participantQos, chatConfig());
+
+#ifdef FASTDDS_CHAT_STATISTICS
+        enableStatisticsWriters(participantQos);
+#endif
+
+        if (chatConfig().useDiscoveryServer()) {
+            addDiscoveryServer(participantQos, chatConfig());
+        }
+        else {
+            addInitialPeers(participantQos, chatConfig(), domain_id);
+        }
+
+        DomainParticipant* participant = DomainParticipantFactory::get_instance()->create_participant(domain_id, participantQos);
+
+        if (participant == nullptr) {
+            return nullptr;
+        }
+
+        type = TypeSupport(createUserChatType(chatConfig()));
+        type.register_type(participant);
+        registerControlTypes(participant);
+        return participant;
+    }
+
+    // A second participant only helps over UDP: with TCP it would need a listening port of its own
+    static bool hasBase() {
+        return chatDomainId(chatConfig()) != chatConfig().domain_id && !chatConfig().use_tcp;
+    }
+
+public:
+    ChatParticipant(const ChatParticipant&) = delete;
+    ChatParticipant& operator=(const ChatParticipant&) = delete;
+
+    // Creates the participant on first use, returns nullptr if that failed
+    static DomainParticipant* acquire() {
+        ChatParticipant& chat = instance();
+        std::lock_guard<std::mutex> lock(chat.mtx);
+
+        if (chat.participant_ == nullptr) {
+            chat.participant_ = create(chatDomainId(chatConfig()), "Participant_chat", chat.type_);
+
+            if (chat.participant_ == nullptr) {
+                return nullptr;
+            }
+        }
+
+        chat.users++;
+        return chat.participant_;
+    }
+
+    // Deletes the participant once the last Publisher/Subscriber is gone. Their entities must be deleted first.
+    static void release() {
+        ChatParticipant& chat = instance();
+        std::lock_guard<std::mutex> lock(chat.mtx);
+
+        if (chat.users == 0) return;
+
+        chat.users--;
+
+        if (chat.users == 0 && chat.participant_ != nullptr) {
+            DomainParticipantFactory::get_instance()->delete_participant(chat.participant_);
+            chat.participant_ = nullptr;
+        }
+    }
+
+    // A participant in domain_id whatever the shard, the same one as acquire() without shards (or with TCP)
+    static DomainParticipant* acquireBase() {
+        if (!hasBase()) return acquire();
+
+        ChatParticipant& chat = instance();
+        std::lock_guard<std::mutex> lock(chat.mtx);
+
+        if (chat.base_participant_ == nullptr) {
+            chat.base_participant_ = create(chatConfig().domain_id, "Participant_chat_base", chat.base_type_);
+
+            if (chat.base_participant_ == nullptr) {
+                return nullptr;
+            }
+        }
+
+        chat.base_users++;
+        return chat.base_participant_;
+    }
+
+    static void releaseBase() {
+        if (!hasBase()) {
+            release();
+            return;
+        }
+
+        ChatParticipant& chat = instance();
+        std::lock_guard<std::mutex> lock(chat.mtx);
+
+        if (chat.base_users == 0) return;
+
+        chat.base_users--;
+
+        if (chat.base_users == 0 && chat.base_participant_ != nullptr) {
+            DomainParticipantFactory::get_instance()->delete_participant(chat.base_participant_);
+            chat.base_participant_ = nullptr;
+        }
+    }
+};
+
+#endif
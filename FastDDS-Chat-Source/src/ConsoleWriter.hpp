@@ -0,0 +1,250 @@
+/**
+ * @file ConsoleWriter.hpp
+ */
+
+#ifndef CONSOLEWRITER_H
+#define CONSOLEWRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Trace.hpp"
+
+// What LineEditor is showing at the bottom of the terminal. Output moves it out of the way
+// and draws it again underneath, so incoming messages never land in the middle of typing.
+struct InputLine {
+    bool active;
+    std::string prompt;
+    std::string text;
+    size_t cursor;          // Byte offset into text
+
+    InputLine() : active(false), cursor(0) {}
+
+    // Columns between the cursor and the end of text (UTF-8 continuation bytes don't count)
+    size_t columnsAfterCursor() const {
+        size_t columns = 0;
+
+        for (size_t i = cursor; i < text.size(); i++) {
+            if ((static_cast<unsigned char>(text[i]) & 0xc0) != 0x80) columns++;
+        }
+
+        return columns;
+    }
+
+    // The whole line from column 0, leaving the terminal cursor where the editing cursor is
+    std::string render() const {
+        std::string out = prompt + text;
+        size_t back = columnsAfterCursor();
+
+        if (back > 0) out += "\033[" + std::to_string(back) + "D";
+        return out;
+    }
+};
+
+// Single output thread for everything printed while chats are running.
+// DDS listeners and the Publisher threads only push onto a lock-free queue,
+// the output thread joins whatever is queued into one buffered write.
+class ConsoleWriter {
+private:
+    // Node of the multi-producer single-consumer queue (Vyukov style)
+    struct Node {
+        std::atomic<Node*> next;
+        std::string text;
+
+        Node() : next(nullptr) {}
+    };
+
+    static const size_t MAX_BATCH_BYTES = 64 * 1024;
+
+    std::atomic<Node*> head;    // Producers push here
+    Node* tail;                 // Only touched by the output thread
+    Node stub;
+
+    std::atomic<bool> running;
+    std::atomic<bool> sleeping;          // Output thread is waiting for work
+    std::atomic<unsigned long long> queued;
+    std::atomic<unsigned long long> written;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+
+    std::mutex term_mtx;        // Held for every write to the terminal
+    InputLine input;            // Only touched with term_mtx held
+    std::function<void(const std::string&)> sink;  // Takes the output instead of the terminal (split view)
+
+    ConsoleWriter() : head(&stub), tail(&stub), running(true), sleeping(false), queued(0), written(0) {
+        worker = std::thread(&ConsoleWriter::run, this);
+    }
+
+    void push(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Returns nullptr when empty (or when a producer is halfway through a push)
+    Node* pop() {
+        Node* t = tail;
+        Node* next = t->next.load(std::memory_order_acquire);
+
+        if (t == &stub) {
+            if (next == nullptr) return nullptr;
+
+            tail = next;
+            t = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+
+        if (t != head.load(std::memory_order_acquire)) return nullptr;
+
+        push(&stub);
+
+        next = t->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+
+        return nullptr;
+    }
+
+    // Drains the queue into batch, returns how many lines were taken
+    unsigned long long drain(std::string& batch) {
+        unsigned long long count = 0;
+        Node* node = nullptr;
+
+        while (batch.size() < MAX_BATCH_BYTES && (node = pop()) != nullptr) {
+            batch += node->text;
+            delete node;
+            count++;
+        }
+
+        return count;
+    }
+
+    void run() {
+        CHAT_TRACE_THREAD("console");
+
+        std::string batch;
+        batch.reserve(MAX_BATCH_BYTES);
+
+        while (true) {
+            batch.clear();
+            unsigned long long count = drain(batch);
+
+            if (count > 0) {
+                CHAT_TRACE_SPAN_ARG("console_write", "lines", count);
+                std::lock_guard<std::mutex> lock(term_mtx);
+
+                if (sink) {
+                    sink(batch);
+                    written.fetch_add(count);
+                    continue;
+                }
+
+                // Only the input line is damaged: clear it, print above it, put it back
+                if (input.active) {
+                    batch = "\r\033[K" + batch + input.render();
+                }
+
+                std::cout.write(batch.data(), batch.size());
+                std::cout.flush();
+                written.fetch_add(count);
+                continue;
+            }
+
+            if (!running.load()) break;
+
+            // Nothing queued, sleep until a producer wakes us up
+            std::unique_lock<std::mutex> lock(mtx);
+            sleeping.store(true);
+
+            if (queued.load() == written.load() && running.load()) {
+                cv.wait_for(lock, std::chrono::milliseconds(100));
+            }
+
+            sleeping.store(false);
+        }
+    }
+
+public:
+    ConsoleWriter(const ConsoleWriter&) = delete;
+    ConsoleWriter& operator=(const ConsoleWriter&) = delete;
+
+    ~ConsoleWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running.store(false);
+        }
+        cv.notify_one();
+
+        if (worker.joinable()) worker.join();
+    }
+
+    static ConsoleWriter& get() {
+        static ConsoleWriter instance;
+        return instance;
+    }
+
+    // Never blocks on the terminal, safe to call from DDS listener threads
+    void write(const std::string& text) {
+        Node* node = new Node();
+        node->text = text;
+
+        queued.fetch_add(1);
+        push(node);
+
+        if (sleeping.load()) {
+            std::lock_guard<std::mutex> lock(mtx);
+            cv.notify_one();
+        }
+    }
+
+    void writeLine(const std::string& text) {
+        write(text + "\n");
+    }
+
+    // Changes the input line while nothing else is writing. edit appends whatever has to be
+    // written to redraw the part it changed, which goes out straight away (local echo doesn't queue).
+    void editInput(const std::function<void(InputLine& input, std::string& out)>& edit) {
+        std::lock_guard<std::mutex> lock(term_mtx);
+        std::string out;
+
+        edit(input, out);
+
+        if (!out.empty()) {
+            std::cout.write(out.data(), out.size());
+            std::cout.flush();
+        }
+    }
+
+    // Sends everything written from now on to sink (on the output thread) instead of the terminal.
+    // An empty function gives the terminal back.
+    void setSink(const std::function<void(const std::string&)>& sink) {
+        std::lock_guard<std::mutex> lock(term_mtx);
+        this->sink = sink;
+    }
+
+    // Waits until everything queued so far has reached the terminal, used before printing straight to std::cout
+    void flush() {
+        unsigned long long target = queued.load();
+
+        while (written.load() < target) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+#endif
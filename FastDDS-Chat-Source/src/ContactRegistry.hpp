@@ -0,0 +1,295 @@
+/**
+ * @file ContactRegistry.hpp
+ */
+
+#ifndef CONTACTREGISTRY_H
+#define CONTACTREGISTRY_H
+
+#include "UserChatPublisher.hpp"
+#include "UserChatSubscriber.hpp"
+#include "SignalChannel.hpp"
+#include "ChatHistory.hpp"
+#include "Reactor.hpp"
+#include "TaskPool.hpp"
+#include "NetStats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+// Keeps std::min/std::max usable in the headers included after this one
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Everything that belongs to one added user. Contacts never move once created,
+// so the Publisher, Subscriber, signal channel and reactor tasks can keep pointers into it.
+// The DDS endpoints are only created by start(), which restored contacts run on BlockingTasks.
+class Contact {
+private:
+    std::string username;
+    ChatHistory history;
+    std::unique_ptr<UserChatPublisher> user_pub;
+    std::unique_ptr<UserChatSubscriber> user_sub;
+    std::unique_ptr<SignalChannel> signals;
+    std::atomic<uint32_t> seen_shown;   // Read index last announced with "(Seen by ...)"
+
+    std::mutex start_mtx;
+    std::condition_variable start_cv;
+    bool started;
+    bool starting;
+    bool failed;                        // An endpoint couldn't be created, the contact stays offline
+    bool queued;                        // startAsync() task hasn't finished yet
+    bool cancelled;                     // Being deleted, a queued start does nothing
+
+public:
+    Contact(std::string username, std::string own_name, std::vector<std::string>* tab)
+        : username(username)
+        , seen_shown(0)
+        , started(false)
+        , starting(false)
+        , failed(false)
+        , queued(false)
+        , cancelled(false)
+    {
+        user_pub.reset(new UserChatPublisher(own_name + "_" + username, own_name, &history));
+        user_sub.reset(new UserChatSubscriber(username + "_" + own_name, &history, tab));
+        signals.reset(new SignalChannel(own_name, username, tab));
+
+        // Says so once the other user has seen everything sent to them, if this chat is open
+        UserChatPublisher* pub = user_pub.get();
+        std::string chat_tab = username + "_" + own_name;
+
+        user_pub->setReceiptCallback([this, pub, tab, chat_tab](uint32_t, uint32_t read) {
+            if (read == 0 || read < pub->getSentIndex() || seen_shown.exchange(read) == read) return;
+
+            if (isChatOpen(tab, chat_tab)) {
+                ConsoleWriter::get().writeLine("(Seen by " + this->username + ")");
+            }
+        });
+
+    }
+
+    Contact(const Contact&) = delete;
+    Contact& operator=(const Contact&) = delete;
+
+    ~Contact() {
+        // A start on the pool still points here
+        {
+            std::unique_lock<std::mutex> lock(start_mtx);
+            cancelled = true;
+            start_cv.wait(lock, [this]() { return !queued; });
+        }
+
+        // Outbound messages still queued on the reactor point at the Publisher
+        user_pub->stop();
+        Reactor::get().sync();
+
+        NetStats::get().untrack(username);
+    }
+
+    // Creates the DDS endpoints, or waits for the start that is already running. Safe from any thread.
+    // False if they couldn't all be created; that isn't retried, the contact has to be added again.
+    bool start() {
+        {
+            std::unique_lock<std::mutex> lock(start_mtx);
+
+            if (failed) return false;
+
+            if (starting || started) {
+                start_cv.wait(lock, [this]() { return started || failed; });
+                return started;
+            }
+
+            starting = true;
+        }
+
+        if (!user_pub->init() || !user_sub->init() || !signals->init()) {
+            std::lock_guard<std::mutex> lock(start_mtx);
+            failed = true;
+            starting = false;
+            start_cv.notify_all();
+            return false;
+        }
+
+        std::vector<eprosima::fastdds::rtps::GUID_t> guids = user_pub->getWriterGuids();
+        std::vector<eprosima::fastdds::rtps::GUID_t> reader_guids = user_sub->getReaderGuids();
+        guids.insert(guids.end(), reader_guids.begin(), reader_guids.end());
+        NetStats::get().track(username, guids);
+
+        std::lock_guard<std::mutex> lock(start_mtx);
+        started = true;
+        starting = false;
+        start_cv.notify_all();
+        return true;
+    }
+
+    // Runs start() on BlockingTasks and returns straight away
+    void startAsync() {
+        {
+            std::lock_guard<std::mutex> lock(start_mtx);
+            if (started || starting || failed || queued) return;
+            queued = true;
+        }
+
+        BlockingTasks::get().submit([this]() {
+            bool skip;
+            {
+                std::lock_guard<std::mutex> lock(start_mtx);
+                skip = cancelled;
+            }
+
+            if (!skip && !start()) {
+                ConsoleWriter::get().writeLine("Couldn't connect to " + username + ".");
+            }
+
+            // Notified under the lock, the destructor may run as soon as queued is false
+            std::lock_guard<std::mutex> lock(start_mtx);
+            queued = false;
+            start_cv.notify_all();
+        });
+    }
+
+    bool isStarted() {
+        std::lock_guard<std::mutex> lock(start_mtx);
+        return started;
+    }
+
+    bool isFailed() {
+        std::lock_guard<std::mutex> lock(start_mtx);
+        return failed;
+    }
+
+    const std::string& getUsername() const {
+        return username;
+    }
+
+    UserChatPublisher* getPub() {
+        return user_pub.get();
+    }
+
+    UserChatSubscriber* getSub() {
+        return user_sub.get();
+    }
+
+    SignalChannel* getSignals() {
+        return signals.get();
+    }
+
+    ChatHistory* getHistory() {
+        return &history;
+    }
+};
+
+// Added users looked up by name
+class ContactRegistry {
+private:
+    std::unordered_map<std::string, std::unique_ptr<Contact>> contacts;
+
+public:
+    typedef std::unordered_map<std::string, std::unique_ptr<Contact>>::iterator iterator;
+
+    // Returns nullptr if the user was never added
+    Contact* find(const std::string& username) {
+        iterator it = contacts.find(username);
+
+        if (it == contacts.end()) return nullptr;
+        return it->second.get();
+    }
+
+    bool contains(const std::string& username) const {
+        return contacts.count(username) > 0;
+    }
+
+    // Creates the Publisher/Subscriber pair for a new user, returns nullptr if already added.
+    // Nothing is on the network until the contact's start() or startAsync().
+    Contact* add(const std::string& username, const std::string& own_name, std::vector<std::string>* tab) {
+        if (contains(username)) return nullptr;
+
+        Contact* contact = new Contact(username, own_name, tab);
+        contacts[username].reset(contact);
+
+        return contact;
+    }
+
+    // Stops and deletes the user's DDS entities
+    bool remove(const std::string& username) {
+        return contacts.erase(username) > 0;
+    }
+
+    // Writes the usernames one per line, through a temporary file so a crash can't leave half a list
+    bool save(const std::string& filename) const {
+        std::vector<std::string> names;
+
+        for (std::unordered_map<std::string, std::unique_ptr<Contact>>::const_iterator it = contacts.begin(); it != contacts.end(); ++it) {
+            names.push_back(it->first);
+        }
+
+        std::sort(names.begin(), names.end());
+
+        std::string temp_file = filename + ".tmp";
+        {
+            std::ofstream out(temp_file);
+            if (!out) return false;
+
+            for (const std::string& name : names) {
+                out << name << '\n';
+            }
+
+            if (!out) return false;
+        }
+
+        // Replaces the old list in one step, so a crash leaves either the old or the new one
+#ifdef _WIN32
+        return MoveFileExA(temp_file.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(temp_file.c_str(), filename.c_str()) == 0;
+#endif
+    }
+
+    // Usernames saved by save(), empty if there's no list yet
+    static std::vector<std::string> loadNames(const std::string& filename) {
+        std::vector<std::string> names;
+        std::ifstream in(filename);
+        std::string line;
+
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty() && line.find(' ') == std::string::npos) names.push_back(line);
+        }
+
+        return names;
+    }
+
+    void clear() {
+        contacts.clear();
+    }
+
+    size_t size() const {
+        return contacts.size();
+    }
+
+    bool empty() const {
+        return contacts.empty();
+    }
+
+    iterator begin() {
+        return contacts.begin();
+    }
+
+    iterator end() {
+        return contacts.end();
+    }
+};
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @file DeliveryReceipts.hpp
+ */
+
+#ifndef DELIVERYRECEIPTS_H
+#define DELIVERYRECEIPTS_H
+
+#include "ChatControlTypes.hpp"
+#include "QosProfiles.hpp"
+#include "Reactor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Delivery and read receipts for one chat topic, on <topic>_ack (ChatReceipt in ChatControl.idl).
+// One receipt covers every message up to an index, so only the newest
+// one matters and receipts are sent at most once per ACK_COALESCE_MS however fast messages come.
+
+const unsigned int ACK_COALESCE_MS = 200;
+
+inline void receiptQos(DataWriterQos& writerQos, DataReaderQos& readerQos) {
+    // A sender that restarts still gets the latest receipt
+    writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    writerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+    writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+    writerQos.history().depth = 1;
+
+    readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    readerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+    readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+    readerQos.history().depth = 1;
+}
+
+// Receiving side, tells the sender how far it got
+class ReceiptSender {
+private:
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Topic* topic_;
+    DataWriter* writer_;
+
+    std::string topic_name;
+
+    std::mutex mtx;
+    uint32_t delivered;
+    uint32_t read;
+    uint32_t sent_delivered;
+    uint32_t sent_read;
+    unsigned long long timer;           // 0 if no receipt is waiting to go out
+
+    // Sends the newest receipt if it changed, runs on the reactor thread
+    void flush() {
+        std::lock_guard<std::mutex> lock(mtx);
+        timer = 0;
+
+        if (delivered == sent_delivered && read == sent_read) return;
+
+        ChatReceipt receipt;
+        receipt.delivered = delivered;
+        receipt.read = read;
+
+        if (writer_->write(&receipt) == eprosima::fastdds::dds::RETCODE_OK) {
+            sent_delivered = delivered;
+            sent_read = read;
+        }
+    }
+
+public:
+    ReceiptSender(const std::string& topic_name)
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , topic_(nullptr)
+        , writer_(nullptr)
+        , topic_name(topic_name)
+        , delivered(0)
+        , read(0)
+        , sent_delivered(0)
+        , sent_read(0)
+        , timer(0)
+    {}
+
+    ReceiptSender(const ReceiptSender&) = delete;
+    ReceiptSender& operator=(const ReceiptSender&) = delete;
+
+    ~ReceiptSender() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (timer != 0) Reactor::get().cancel(timer);
+            timer = 0;
+        }
+
+        // A flush that already started still points here
+        Reactor::get().sync();
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+        }
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (topic_ != nullptr)
+        {
+            participant_->delete_topic(topic_);
+        }
+    }
+
+    // The participant must outlive this
+    bool init(DomainParticipant* participant)
+    {
+        participant_ = participant;
+        topic_ = participant_->create_topic(topic_name + "_ack", ChatReceipt::typeName(), TOPIC_QOS_DEFAULT);
+
+        if (topic_ == nullptr)
+        {
+            return false;
+        }
+
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        receiptQos(writerQos, readerQos);
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        writer_ = publisher_->create_datawriter(topic_, writerQos, nullptr);
+
+        return writer_ != nullptr;
+    }
+
+    // Everything up to delivered arrived, everything up to read was shown. Sent within ACK_COALESCE_MS.
+    void update(uint32_t delivered, uint32_t read) {
+        if (writer_ == nullptr) return;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        this->delivered = delivered;
+        this->read = read;
+
+        if (timer == 0) {
+            timer = Reactor::get().schedule(std::chrono::milliseconds(ACK_COALESCE_MS), [this]() { flush(); });
+        }
+    }
+};
+
+// Sending side, keeps the newest receipt from the other user
+class ReceiptReader {
+public:
+    typedef std::function<void(uint32_t delivered, uint32_t read)> ReceiptCallback;
+
+private:
+    DomainParticipant* participant_;
+    Subscriber* subscriber_;
+    Topic* topic_;
+    DataReader* reader_;
+
+    std::string topic_name;
+    std::atomic<uint32_t> delivered;
+    std::atomic<uint32_t> read;
+    ReceiptCallback on_receipt;
+
+    std::mutex receipt_mtx;             // Keeps the compare and update of a receipt together
+    eprosima::fastdds::rtps::InstanceHandle_t writer_handle;   // Writer the current receipt came from
+
+    class ReceiptListener : public DataReaderListener
+    {
+    private:
+        ReceiptReader* receipts_;
+        ChatReceipt receipt_;
+    public:
+        ReceiptListener(ReceiptReader* receipts) : receipts_(receipts) {}
+        ~ReceiptListener() override {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&receipt_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data) {
+                    receipts_->received(info.publication_handle, receipt_.delivered, receipt_.read);
+                }
+            }
+        }
+    } listener_;
+
+    // A receipt never goes back, unless it comes from a new writer (the other user restarted)
+    void received(const eprosima::fastdds::rtps::InstanceHandle_t& handle, uint32_t new_delivered, uint32_t new_read) {
+        {
+            std::lock_guard<std::mutex> lock(receipt_mtx);
+
+            if (handle == writer_handle) {
+                if (new_delivered < delivered.load()) new_delivered = delivered.load();
+                if (new_read < read.load()) new_read = read.load();
+            }
+
+            writer_handle = handle;
+
+            if (new_delivered == delivered.load() && new_read == read.load()) return;
+
+            delivered = new_delivered;
+            read = new_read;
+        }
+
+        if (on_receipt) on_receipt(new_delivered, new_read);
+    }
+
+public:
+    // on_receipt runs on a Fast DDS thread when a receipt changes something
+    ReceiptReader(const std::string& topic_name, ReceiptCallback on_receipt)
+        : participant_(nullptr)
+        , subscriber_(nullptr)
+        , topic_(nullptr)
+        , reader_(nullptr)
+        , topic_name(topic_name)
+        , delivered(0)
+        , read(0)
+        , on_receipt(on_receipt)
+        , listener_(this)
+    {}
+
+    ReceiptReader(const ReceiptReader&) = delete;
+    ReceiptReader& operator=(const ReceiptReader&) = delete;
+
+    ~ReceiptReader() {
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (topic_ != nullptr)
+        {
+            participant_->delete_topic(topic_);
+        }
+    }
+
+    // The participant must outlive this
+    bool init(DomainParticipant* participant)
+    {
+        participant_ = participant;
+        topic_ = participant_->create_topic(topic_name + "_ack", ChatReceipt::typeName(), TOPIC_QOS_DEFAULT);
+
+        if (topic_ == nullptr)
+        {
+            return false;
+        }
+
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        receiptQos(writerQos, readerQos);
+
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(topic_, readerQos, &listener_);
+
+        return reader_ != nullptr;
+    }
+
+    uint32_t getDelivered() const {
+        return delivered.load();
+    }
+
+    uint32_t getRead() const {
+        return read.load();
+    }
+};
+
+#endif
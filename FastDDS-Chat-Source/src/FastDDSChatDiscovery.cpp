@@ -0,0 +1,65 @@
+// FastDDSChatDiscovery.cpp : Discovery Server for FastDDSUser clients started with --discovery-server.
+//
+
+#include "ChatConfig.hpp"
+#include "TransportProfile.hpp"
+
+#include <iostream>
+#include <string>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+int main(int argc, char** argv)
+{
+    std::string ip = "0.0.0.0";
+    uint16_t port = DEFAULT_DISCOVERY_SERVER_PORT;
+    ChatConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--tcp") {
+            config.use_tcp = true;
+        }
+        else if (arg == "--domain-id" && i + 1 < argc) {
+            if (!applyOption(config, "domain_id", argv[++i])) return 1;
+        }
+        else if (!parseAddress(arg, ip, port)) {
+            std::cerr << "Usage: " << argv[0] << " [listen_ip[:port]] [--tcp] [--domain-id <id>]" << std::endl;
+            return 1;
+        }
+    }
+
+    DomainParticipantQos participantQos;
+    participantQos.name("Participant_discovery_server");
+
+    // Clients started with --tcp need the server on TCP as well
+    config.tcp_port = port;
+    applyTransport(participantQos, config);
+
+    eprosima::fastdds::rtps::Locator_t locator = makeLocator(ip, port, config);
+
+    participantQos.wire_protocol().builtin.discovery_config.discoveryProtocol = eprosima::fastdds::rtps::DiscoveryProtocol::SERVER;
+    participantQos.wire_protocol().builtin.metatrafficUnicastLocatorList.push_back(locator);
+
+    DomainParticipant* participant = DomainParticipantFactory::get_instance()->create_participant(config.domain_id, participantQos);
+
+    if (participant == nullptr) {
+        std::cerr << "Error creating discovery server on " << ip << ":" << port << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Fast-DDS Chat Discovery Server" << std::endl;
+    std::cout << "----------------------------" << std::endl;
+    std::cout << "Listening on " << ip << ":" << port << (config.use_tcp ? " (TCP)" : "") << ". Press enter to stop." << std::endl;
+
+    std::string line;
+    std::getline(std::cin, line);
+
+    DomainParticipantFactory::get_instance()->delete_participant(participant);
+
+    return 0;
+}
@@ -4,6 +4,15 @@
 #include "UserChatPublisher.hpp"
 #include "UserChatSubscriber.hpp"
 #include "Globals.hpp"
+#include "ConsoleWriter.hpp"
+#include "ContactRegistry.hpp"
+#include "ChatConfig.hpp"
+#include "PresenceRoster.hpp"
+#include "LineEditor.hpp"
+#include "SplitView.hpp"
+#include "AnnouncementChannel.hpp"
+#include "NetStats.hpp"
+#include "Trace.hpp"
 
 #include <iostream>
 #include <vector>
@@ -44,105 +53,49 @@ void resetTextColor() {
 //std::vector<std::string> endThreadSignal = {};  // Lets threads know to end
 std::vector<std::string> curr_chat_tab = {};    // Tells which tabbed user is currently being talked to (option 3)
 
-// Class for representing a Subscriber
-class sub_thread {
-private:
-    UserChatSubscriber* user_sub;
-    std::string sub_topic;
-    std::thread st;
-    std::vector<std::string>* curr_history;
-    std::vector<std::string>* curr_tab;
-
-public:
-    sub_thread(std::string sub_topic, std::vector<std::string>& history, std::vector<std::string>& tab) : curr_history(&history), curr_tab(&tab) {
-        this->sub_topic = sub_topic;
-        user_sub = new UserChatSubscriber(sub_topic, curr_history, curr_tab);
-        user_sub->init();
-        st = std::thread(&sub_thread::run, this, sub_topic);
-    }
-
-    void run(std::string topic) {
-        user_sub->run(topic);
-    }
-
-    UserChatSubscriber* getSub() {
-        return user_sub;
-    }
-
-    std::thread* getThread() {
-        return &st;
-    }
-
-    std::vector<std::string>* getHistory() {
-        return curr_history;
-    }
-};
-
-// Class for representing a Publisher
-class pub_thread {
-private:
-    UserChatPublisher* user_pub;
-    std::string pub_topic;
-    std::thread pt;
-    std::vector<std::string>* curr_history;
-
-public:
-    pub_thread(std::string pub_topic, std::string name, std::vector<std::string>& history) : curr_history(&history) {
-        this->pub_topic = pub_topic;
-        user_pub = new UserChatPublisher(pub_topic, name, curr_history);
-        user_pub->init();
-        pt = std::thread(&pub_thread::run, this);
-    }
+// Where a user's contacts are kept between runs
+std::string contactListFile(const std::string& username) {
+    return "./" + username + "_contacts.txt";
+}
 
-    void run() {
-        user_pub->run();
-    }
+// Adds the contacts saved last time. Their endpoints are created in the background (or when
+// their chat is first opened with contact_startup = lazy), so the menu doesn't wait for them.
+void restoreContacts(ContactRegistry& contacts, const std::string& username) {
+    std::vector<std::string> names = ContactRegistry::loadNames(contactListFile(username));
+    size_t restored = 0;
 
-    UserChatPublisher* getPub() {
-        return user_pub;
-    }
+    for (const std::string& name : names) {
+        if (name == username) continue;
 
-    std::thread* getThread() {
-        return &pt;
-    }
+        Contact* contact = contacts.add(name, username, &curr_chat_tab);
+        if (contact == nullptr) continue;
 
-    std::vector<std::string>* getHistory() {
-        return curr_history;
+        if (chatConfig().contact_startup != "lazy") contact->startAsync();
+        restored++;
     }
-};
-
-// Find index of element in vector
-int findIndex(std::vector<std::string> vector, std::string search) {
-    auto f = std::find(vector.begin(), vector.end(), search);
 
-    if (f != vector.end()) {
-        return f - vector.begin();
-    }
-    else {
-        return -1;
+    if (restored > 0) {
+        std::cout << "Restored " << restored << " contact(s)." << std::endl;
     }
 }
 
 // View users currently added
-void viewUsers(std::vector<std::string>& threaded_usernames, std::vector<pub_thread>& pubs) {
+void viewUsers(ContactRegistry& contacts) {
     std::cout << std::endl << "These are the users you are currently connected to:" << std::endl;
 
-    int i = 0;
-    for (std::string& user : threaded_usernames) {
-        bool curr_status = pubs.at(i).getPub()->getStatus();
+    for (ContactRegistry::iterator it = contacts.begin(); it != contacts.end(); ++it) {
+        bool curr_status = PresenceRoster::get().isOnline(it->first);
         std::string str = "";
 
         if (curr_status) str = "online";
         else str = "offline";
 
-        std::cout << "  " + user + " (" + str + ")" << std::endl;
-
-        i++;
+        std::cout << "  " + it->first + " (" + str + ")" << std::endl;
     }
 }
 
 // Add new user
-void addUser(std::vector<pub_thread>& pubs, std::vector<sub_thread>& subs, std::vector<std::string>& threaded_usernames, std::string username, std::vector<std::vector<std::string>>& chat_histories) {
+void addUser(ContactRegistry& contacts, const std::string& username) {
     std::string new_user = "";
 
     while (true) {
@@ -158,7 +111,7 @@ void addUser(std::vector<pub_thread>& pubs, std::vector<sub_thread>& subs, std::
             if (new_user == username) {
                 std::cout << "You can't add yourself. Try again." << std::endl;
             }
-            else if (findIndex(threaded_usernames, new_user) != -1) {
+            else if (contacts.contains(new_user)) {
                 std::cout << "You can't add a user you already added." << std::endl;
             }
             else {
@@ -167,55 +120,30 @@ void addUser(std::vector<pub_thread>& pubs, std::vector<sub_thread>& subs, std::
         }
     }
 
-    std::vector<std::string> temp_history = {};
-    chat_histories.push_back(temp_history);
-
-    pub_thread pub(username + "_" + new_user, username, chat_histories.at(chat_histories.size()-1));
-    sub_thread sub(new_user + "_" + username, chat_histories.at(chat_histories.size() - 1), curr_chat_tab);
-
-    pubs.push_back(std::move(pub));
-    subs.push_back(std::move(sub));
+    if (!contacts.add(new_user, username, &curr_chat_tab)->start()) {
+        contacts.remove(new_user);
+        std::cerr << "Couldn't connect to " + new_user + ", they weren't added." << std::endl;
+        return;
+    }
 
-    threaded_usernames.push_back(new_user);
+    if (!contacts.save(contactListFile(username))) {
+        std::cerr << "Could not save the contact list." << std::endl;
+    }
 
     std::cout << "Successfully added " + new_user + "." << std::endl;
 }
 
 // Remove user
-void removeUser(std::vector<pub_thread>& pubs, std::vector<sub_thread>& subs, std::vector<std::string>& threaded_usernames, std::string removed_user, std::string username, std::vector<std::vector<std::string>>& chat_histories) {
-    int index = findIndex(threaded_usernames, removed_user);
-
-    if (index == -1) {
+void removeUser(ContactRegistry& contacts, const std::string& username, const std::string& removed_user) {
+    if (!contacts.remove(removed_user)) {
         std::cout << "Error: User was not found." << std::endl;
         return;
     }
 
-    threaded_usernames.erase(threaded_usernames.begin() + index);
-
-    std::string temp_pub_topic = username + "_" + removed_user;
-    std::string temp_sub_topic = removed_user + "_" + username;
-
-    endThreadSignal.push_back(temp_pub_topic);
-    endThreadSignal.push_back(temp_sub_topic);
-
-    if (pubs.at(index).getThread()->joinable()) {
-        pubs.at(index).getThread()->join();
+    if (!contacts.save(contactListFile(username))) {
+        std::cerr << "Could not save the contact list." << std::endl;
     }
 
-    if (subs.at(index).getThread()->joinable()) {
-        subs.at(index).getThread()->join();
-    }
-
-    delete pubs.at(index).getPub();
-    delete subs.at(index).getSub();
-
-    pubs.erase(pubs.begin() + index);
-    subs.erase(subs.begin() + index);
-
-    chat_histories.erase(chat_histories.begin() + index);
-
-    endThreadSignal.clear();
-
     std::cout << removed_user + " has been successfully removed." << std::endl;
 }
 
@@ -228,7 +156,9 @@ void printHomeMenu() {
     std::cout << "  4. Remove a user." << std::endl;
     std::cout << "  5. Save chat log." << std::endl;
     std::cout << "  6. Change color of text." << std::endl;
-    std::cout << "  7. Exit the program." << std::endl << std::endl;
+    std::cout << "  7. Split view with several chats." << std::endl;
+    std::cout << "  8. Send an announcement to everyone." << std::endl;
+    std::cout << "  9. Exit the program." << std::endl << std::endl;
 }
 
 // Get login info
@@ -256,22 +186,33 @@ void getCredentials(std::string& username) {
     std::cout << std::endl;
 }
 
-void chatUser(std::string username, std::string other_user, std::vector<std::string> threaded_usernames, std::vector<pub_thread>& pubs, std::vector<sub_thread>& subs, std::vector<std::vector<std::string>>& chat_histories) {
-    int index = findIndex(threaded_usernames, other_user);
+void chatUser(const std::string& username, const std::string& other_user, ContactRegistry& contacts) {
+    Contact* contact = contacts.find(other_user);
 
-    if (index == -1) {
+    if (contact == nullptr) {
         std::cout << "Invalid username." << std::endl;
         return;
     }
 
+    // Restored contacts may still be starting, or not started at all if they're lazy
+    if (!contact->isStarted()) {
+        std::cout << "Connecting to " << other_user << "..." << std::endl;
+
+        if (!contact->start()) {
+            std::cout << "Couldn't connect to " << other_user << ". Remove them and add them again to retry." << std::endl;
+            return;
+        }
+    }
+
     std::cout << std::endl << "Here's your current history with " + other_user + ":" << std::endl;
 
-    std::vector<std::string>* temp_history = pubs.at(index).getHistory();
+    ChatHistory* temp_history = contact->getHistory();
+    size_t cursor = 0;
 
+    // Only the latest page is printed, /more pages back through the rest
     if (!temp_history->empty()) {
-        for (std::string& str : *temp_history) {
-            std::cout << str << std::endl;
-        }
+        cursor = temp_history->printPage(temp_history->size(), SCROLLBACK_PAGE_SIZE);
+        ConsoleWriter::get().flush();
     }
     else {
         std::cout << "This is the start of your history with " + other_user + "." << std::endl;
@@ -279,49 +220,181 @@ void chatUser(std::string username, std::string other_user, std::vector<std::str
 
     std::cout << std::endl;
 
-    curr_chat_tab.at(0) = "in";
-    curr_chat_tab.at(1) = other_user + "_" + username;
-    pubs.at(index).getPub()->setActive(true);   // Allows typing messages in Publisher
-    while (pubs.at(index).getPub()->getActive() == true) {
+    setChatTab(&curr_chat_tab, "in", other_user + "_" + username);
+
+    // Input is read here, the reactor thread does the publishing
+    UserChatPublisher* pub = contact->getPub();
+    SignalChannel* signals = contact->getSignals();
+    std::string message = "";
+
+    // Everything shown above counts as read
+    contact->getSub()->markRead();
+
+    if (signals->isPeerTyping()) {
+        std::cout << "(" << other_user << " is typing...)" << std::endl;
     }
 
-    curr_chat_tab.at(0) = "";
-    curr_chat_tab.at(1) = "";
+    // Raw mode until the chat is left. Messages that arrive while typing go above the input line.
+    LineEditor editor;
+
+    // Piped input can't see key presses, so the prompt being ready counts as typing
+    if (!editor.isRaw()) signals->signal(SIGNAL_TYPING);
+
+    while (true) {
+        bool offline = false;
+
+        LineEditor::Result result = editor.readLine("> ", message,
+            [&offline, &other_user]() {
+                offline = !PresenceRoster::get().isOnline(other_user);
+                return !offline;
+            },
+            [signals]() { signals->signal(SIGNAL_TYPING); });
+
+        if (offline) {
+            ConsoleWriter::get().flush();
+            std::cout << "Other user is offline now." << std::endl;
+            break;
+        }
+
+        if (result == LineEditor::CLOSED || message == "/exit") {
+            break;
+        }
+
+        // From Enter to the line being queued (or the command done)
+        CHAT_TRACE_SPAN("input");
+
+        if (message == "/status") {
+            SendQueueStats stats = pub->getQueueStats();
+
+            ConsoleWriter::get().writeLine("Sent " + std::to_string(pub->getSentIndex())
+                + ", delivered " + std::to_string(pub->getDeliveredIndex())
+                + ", read " + std::to_string(pub->getReadIndex()) + ".");
+            ConsoleWriter::get().writeLine("Not acknowledged " + std::to_string(stats.depth)
+                + " (most " + std::to_string(stats.high_water) + "), not sent yet " + std::to_string(stats.outbox)
+                + ", dropped " + std::to_string(stats.drops) + ".");
+        }
+        else if (message == "/netstats" || message == "/netstats save") {
+            if (!NetStats::available()) {
+                ConsoleWriter::get().writeLine("Network statistics need a build with FASTDDS_CHAT_STATISTICS.");
+            }
+            else if (message == "/netstats") {
+                ConsoleWriter::get().writeLine(NetStats::get().describe(other_user));
+            }
+            else {
+                // Every contact, not only this one
+                std::string filename = "./ChatLogs/" + username + "_netstats.csv";
+
+                if (NetStats::get().exportCsv(filename)) {
+                    ConsoleWriter::get().writeLine("Network statistics saved to " + filename + ".");
+                }
+                else {
+                    ConsoleWriter::get().writeLine("Couldn't write " + filename + ".");
+                }
+            }
+        }
+        else if (message == "/trace") {
+            std::string filename = "./ChatLogs/" + username + "_trace.json";
+
+            if (!traceAvailable()) {
+                ConsoleWriter::get().writeLine("Tracing needs a build with FASTDDS_CHAT_TRACE.");
+            }
+            else if (writeTrace(filename)) {
+                ConsoleWriter::get().writeLine("Trace saved to " + filename + ", open it in Perfetto.");
+            }
+            else {
+                ConsoleWriter::get().writeLine("Couldn't write " + filename + ".");
+            }
+        }
+        else if (message == "/more") {
+            if (cursor == 0) {
+                ConsoleWriter::get().writeLine("This is the start of your history.");
+            }
+            else {
+                ConsoleWriter::get().writeLine("--- Earlier messages ---");
+                cursor = temp_history->printPage(cursor, SCROLLBACK_PAGE_SIZE);
+                ConsoleWriter::get().writeLine("------------------------");
+            }
+        }
+        else if (message.compare(0, 8, "/search ") == 0 && message.size() > 8) {
+            std::vector<std::string> results;
+            temp_history->search(message.substr(8), SCROLLBACK_PAGE_SIZE, results);
+
+            std::string out = "--- " + std::to_string(results.size()) + " found ---\n";
+
+            for (std::string& str : results) {
+                out += str + "\n";
+            }
+
+            ConsoleWriter::get().write(out + "------------------------\n");
+        }
+        else if (message != "" && !pub->getStatus()) {
+            // Online only means their presence is seen, the chat writer may not have matched yet
+            ConsoleWriter::get().writeLine(other_user + " is online but the chat isn't connected yet. Message discarded.");
+        }
+        else if (message.compare(0, 8, "/urgent ") == 0 && message.size() > 8) {
+            // Skips the outbox, so it goes out ahead of anything still waiting there
+            PublishResult result = pub->sendUrgent(message.substr(8));
+
+            if (result == PUBLISH_QUEUE_FULL) {
+                ConsoleWriter::get().writeLine(other_user + " hasn't caught up with your urgent messages. Message discarded.");
+            }
+            else if (result == PUBLISH_NOT_MATCHED) {
+                ConsoleWriter::get().writeLine("Other user is offline now. Message discarded.");
+            }
+            else if (result == PUBLISH_ERROR) {
+                ConsoleWriter::get().writeLine("Error sending message. Message discarded.");
+            }
+        }
+        else if (message != "") {
+            if (!pub->send(message)) {
+                ConsoleWriter::get().writeLine(other_user + " isn't keeping up. Message discarded.");
+            }
+
+            if (!editor.isRaw()) signals->signal(SIGNAL_TYPING);
+        }
+    }
+
+    signals->signal(SIGNAL_IDLE);
+
+    setChatTab(&curr_chat_tab, "", "");
+
+    // Let anything printed during the chat reach the terminal before the menu comes back
+    ConsoleWriter::get().flush();
 
     std::cout << "Leaving chat with " + other_user + "." << std::endl;
 }
 
-void saveChat(std::string username, std::vector<std::string> threaded_usernames, std::vector<std::vector<std::string>> chat_histories) {
+void saveChat(const std::string& username, ContactRegistry& contacts) {
     std::string saveUser;
     std::cout << std::endl << "Which ongoing chat would you like to save?: ";
 
     std::cin >> saveUser;
     std::cin.ignore();
 
-    int index = findIndex(threaded_usernames, saveUser);
+    Contact* contact = contacts.find(saveUser);
 
-    if (index == -1) {
+    if (contact == nullptr) {
         std::cout << "You aren't currently chatting with a user named " << saveUser << "." << std::endl;
         return;
     }
 
-    std::vector<std::string> curr_history = chat_histories.at(index);
+    ChatHistory* curr_history = contact->getHistory();
 
-    if (curr_history.empty()) {
+    if (curr_history->empty()) {
         std::cout << "You've added " << saveUser << ", but you haven't chatted with them yet." << std::endl;
         return;
     }
 
     auto now = std::chrono::system_clock::now();
     std::time_t currentTime = std::chrono::system_clock::to_time_t(now);
-    std::tm* timeInfo = std::localtime(&currentTime);
+    std::tm timeInfo = localTime(currentTime);
 
     std::ostringstream dateStream;
-    dateStream << std::put_time(timeInfo, "%m-%d-%y");
+    dateStream << std::put_time(&timeInfo, "%m-%d-%y");
     std::string date = dateStream.str();
     
     std::ostringstream timeStream;
-    timeStream << std::put_time(timeInfo, "%H-%M-%S");
+    timeStream << std::put_time(&timeInfo, "%H-%M-%S");
     std::string time = timeStream.str();
 
     // Format - Username_ChattedUser_MM-DD-YY_HH-MM-SS.txt
@@ -334,15 +407,31 @@ void saveChat(std::string username, std::vector<std::string> threaded_usernames,
         return;
     }
 
-    for (std::string& str : curr_history) {
-        chatLog << str << std::endl;
-    }
+    // Goes through the history a line at a time so older messages aren't all read back into memory
+    curr_history->forEach([&chatLog](const std::string& str) { chatLog << str << '\n'; });
 
     chatLog.close();
 
     std::cout << "File " << filename << " was created." << std::endl;
 }
 
+// One multicast write to every user on the domain, see AnnouncementChannel.hpp
+void sendAnnouncement() {
+    std::string text = "";
+
+    std::cout << std::endl << "Announcement (empty to cancel): ";
+    std::getline(std::cin, text);
+
+    if (text.empty()) return;
+
+    if (AnnouncementChannel::get().announce(text)) {
+        std::cout << "Announcement sent." << std::endl;
+    }
+    else {
+        std::cout << "Could not send the announcement." << std::endl;
+    }
+}
+
 void changeColor() {
     std::cout << std::endl << "Which color would you like to choose?" << std::endl;
 
@@ -412,16 +501,16 @@ void changeColor() {
     }
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    if (!parseArgs(argc, argv)) return 1;
+
+    CHAT_TRACE_THREAD("main");
+
     curr_chat_tab.push_back("");
     curr_chat_tab.push_back("");
 
-    std::vector<pub_thread> pubs = {};
-    std::vector<sub_thread> subs = {};
-    std::vector<std::vector<std::string>> chat_histories = {};
-
-    std::vector<std::string> threaded_usernames = {};
+    ContactRegistry contacts;
 
     std::string username = "";
 
@@ -430,8 +519,40 @@ int main()
 
     getCredentials(username);
 
+    if (chatConfig().useDiscoveryServer()) {
+        std::cout << "Using discovery server at " << chatConfig().discovery_server_ip << ":" << chatConfig().discovery_server_port << "." << std::endl;
+    }
+
+    if (chatDomainId(chatConfig()) != 0 || chatConfig().qos_profile != "default") {
+        std::cout << "Domain " << chatDomainId(chatConfig()) << ", QoS profile " << chatConfig().qos_profile << "." << std::endl;
+    }
+
+    // Only users sharing a partition see each other
+    if (!chatPartitions(chatConfig()).empty()) {
+        std::cout << "Partition " << chatConfig().partition << "." << std::endl;
+    }
+
+    // Announcements get a participant in domain_id of their own, which TCP can't listen for twice
+    if (chatConfig().use_tcp && chatDomainId(chatConfig()) != chatConfig().domain_id) {
+        std::cout << "Announcements only reach users on domain " << chatDomainId(chatConfig()) << " with TCP and partition_shards." << std::endl;
+    }
+
     std::cout << "----------------------------" << std::endl << std::endl;
 
+    if (!PresenceRoster::get().init(username)) {
+        std::cerr << "Error starting presence, users will show as offline." << std::endl;
+    }
+
+    if (!AnnouncementChannel::get().init(username)) {
+        std::cerr << "Error starting announcements, you won't receive any." << std::endl;
+    }
+
+    if (!NetStats::get().init()) {
+        std::cerr << "Error reading network statistics, /netstats will stay empty." << std::endl;
+    }
+
+    restoreContacts(contacts, username);
+
     std::cout << "Welcome, " + username + "." << std::endl;
 
     while (true) {
@@ -453,15 +574,15 @@ int main()
         }
 
         if (option == 1) {
-            if (!threaded_usernames.empty()) {
-                viewUsers(threaded_usernames, pubs);
+            if (!contacts.empty()) {
+                viewUsers(contacts);
             }
             else {
                 std::cout << std::endl << "You have no Users added yet." << std::endl;
             }
         }
         else if (option == 2) {
-            addUser(pubs, subs, threaded_usernames, username, chat_histories);
+            addUser(contacts, username);
         }
         else if (option == 3) {
             std::string to_chat = "";
@@ -474,7 +595,7 @@ int main()
                 std::cout << "Invalid username: can't talk to yourself." << std::endl;
             }
             else {
-                chatUser(username, to_chat, threaded_usernames, pubs, subs, chat_histories);
+                chatUser(username, to_chat, contacts);
             }
         }
         else if (option == 4) {
@@ -484,28 +605,33 @@ int main()
             std::cin >> to_remove;
             std::cin.ignore();
 
-            removeUser(pubs, subs, threaded_usernames, to_remove, username, chat_histories);
+            removeUser(contacts, username, to_remove);
         }
-        else if (option == 5) saveChat(username, threaded_usernames, chat_histories);
+        else if (option == 5) saveChat(username, contacts);
         else if (option == 6) changeColor();
-        else if (option == 7) break;
+        else if (option == 7) {
+            SplitView view(contacts, username);
+
+            if (!view.run()) {
+                std::cout << std::endl << "The split view needs a terminal." << std::endl;
+            }
+        }
+        else if (option == 8) sendAnnouncement();
+        else if (option == 9) break;
         else {
-            std::cout << std::endl << "That's not an option. Try again. (1-5)" << std::endl;
+            std::cout << std::endl << "That's not an option. Try again. (1-9)" << std::endl;
         }
     }
 
     // Clean up threads
-    for (int i = 0; i < pubs.size(); i++) {
-        std::string removed_user = threaded_usernames.at(i);
-
-        std::string temp_pub_topic = username + "_" + removed_user;
-        std::string temp_sub_topic = removed_user + "_" + username;
-
-        endThreadSignal.push_back(temp_pub_topic);
-        endThreadSignal.push_back(temp_sub_topic);
-
-        pubs.at(i).getThread()->join();
-        subs.at(i).getThread()->join();
+    contacts.clear();
+    NetStats::get().shutdown();
+    AnnouncementChannel::get().shutdown();
+    PresenceRoster::get().shutdown();
+
+    // Whatever was recorded this session, /trace saves it earlier
+    if (traceAvailable() && writeTrace("./ChatLogs/" + username + "_trace.json")) {
+        std::cout << "Trace saved to ./ChatLogs/" << username << "_trace.json." << std::endl;
     }
 
     std::cout << std::endl << "Thanks for chatting." << std::endl;
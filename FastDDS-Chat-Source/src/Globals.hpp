@@ -1,11 +1,52 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <string>
 #include <vector>
 
-extern std::vector<std::string> endThreadSignal = {};
 //extern std::vector<std::string> curr_chat_tab;
 
+// Guards curr_chat_tab, the main thread switches it while receiving threads check it
+inline std::mutex& chatTabMutex() {
+    static std::mutex mtx;
+    return mtx;
+}
+
+// Whether the chat on topic is the one open in tab ({"in", topic})
+inline bool isChatOpen(const std::vector<std::string>* tab, const std::string& topic) {
+    std::lock_guard<std::mutex> lock(chatTabMutex());
+    return tab->at(0) == "in" && tab->at(1) == topic;
+}
+
+inline void setChatTab(std::vector<std::string>* tab, const std::string& state, const std::string& topic) {
+    std::lock_guard<std::mutex> lock(chatTabMutex());
+    tab->at(0) = state;
+    tab->at(1) = topic;
+}
+
+// std::localtime shares one buffer between threads, this doesn't
+inline std::tm localTime(std::time_t time) {
+    std::tm result;
+#ifdef _WIN32
+    localtime_s(&result, &time);
+#else
+    localtime_r(&time, &result);
+#endif
+    return result;
+}
+
+// Current time the way asctime() writes it, without the newline
+inline std::string timestampNow() {
+    std::tm local_time = localTime(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
+    char buffer[32];
+
+    if (std::strftime(buffer, sizeof(buffer), "%a %b %e %H:%M:%S %Y", &local_time) == 0) return "";
+    return buffer;
+}
+
 // for colors
 #ifdef _WIN32
 enum Color {
@@ -35,6 +76,9 @@ enum Color {
 };
 #endif
 
+// Put in front of urgent messages (sent with /urgent) in the history and on screen
+const std::string URGENT_MARK = "[urgent] ";
+
 extern void setTextColor(Color color);
 extern void resetTextColor();
 
@@ -0,0 +1,500 @@
+/**
+ * @file HistorySync.hpp
+ */
+
+#ifndef HISTORYSYNC_H
+#define HISTORYSYNC_H
+
+#include "ChatControlTypes.hpp"
+#include "OutboxLog.hpp"
+#include "QosProfiles.hpp"
+#include "Reactor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/DataWriterListener.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// History sync for one chat topic. The side that missed messages (SyncRequester, next to the
+// Subscriber) sends the last index it has on <topic>_sync_req. The sender (SyncReplier, next to
+// the Publisher) answers on <topic>_sync_rep from its OutboxLog, many messages per sample.
+// Both use the ChatSyncRequest/ChatSyncReply types from ChatControl.idl.
+
+// Message text put in one reply sample
+const size_t SYNC_BATCH_BYTES = 16 * 1024;
+
+// Reply samples that can wait for acknowledgement before the replier backs off
+const int32_t SYNC_REPLY_WINDOW = 32;
+
+// Batches sent before letting other reactor tasks (outgoing chat) run
+const int SYNC_BATCHES_PER_TURN = 8;
+
+const unsigned int SYNC_RETRY_MS = 20;
+
+// How long a request waits for the reply reader to match before it's dropped
+const unsigned int SYNC_MATCH_TIMEOUT_MS = 5000;
+
+// Serves sync requests for the messages this user published on one topic
+class SyncReplier {
+private:
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Subscriber* subscriber_;
+    Topic* req_topic_;
+    Topic* rep_topic_;
+    DataWriter* writer_;
+    DataReader* reader_;
+
+    std::string topic_name;
+    std::string username;
+    OutboxLog* log;
+
+    // Range being sent, only touched on the reactor thread
+    uint32_t next;
+    uint32_t last;
+    long long match_deadline;                   // Steady clock ms to give up waiting for the reply reader
+    bool serving;                               // A serve() is already posted or waiting on a timer
+
+    std::atomic<bool> stopped;
+    std::atomic<unsigned long long> retry_timer;
+
+    class RequestListener : public DataReaderListener
+    {
+    private:
+        SyncReplier* replier_;
+        ChatSyncRequest request_;
+    public:
+        RequestListener(SyncReplier* replier) : replier_(replier) {}
+        ~RequestListener() override {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&request_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data) {
+                    replier_->requested(request_.have, request_.upto);
+                }
+            }
+        }
+    } request_listener_;
+
+    class ReplyListener : public DataWriterListener
+    {
+    public:
+        std::atomic<int> matched_;
+
+        ReplyListener() : matched_(0) {}
+        ~ReplyListener() override {}
+
+        void on_publication_matched(DataWriter*, const PublicationMatchedStatus& info) override {
+            matched_ = info.current_count;
+        }
+    } reply_listener_;
+
+    static long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // A new request replaces whatever was being sent
+    void requested(uint32_t have, uint32_t upto) {
+        Reactor::get().post([this, have, upto]() {
+            if (stopped.load()) return;
+
+            uint32_t newest = log->lastIndex();
+
+            next = std::max(have + 1, log->firstIndex());
+            last = (upto == 0 || upto > newest) ? newest : upto;
+            match_deadline = nowMs() + SYNC_MATCH_TIMEOUT_MS;
+
+            // Lets the requester know there is nothing to wait for
+            if (next > last) {
+                sendEmpty();
+                return;
+            }
+
+            if (!serving) serve();
+        });
+    }
+
+    void sendEmpty() {
+        ChatSyncReply reply;
+        reply.first = next;
+        reply.last = last;
+        reply.sender = username;
+        writer_->write(&reply);
+    }
+
+    // Nothing is scheduled once the destructor has started, it couldn't cancel it in time
+    void retryLater() {
+        if (stopped.load()) return;
+
+        serving = true;
+        retry_timer = Reactor::get().schedule(std::chrono::milliseconds(SYNC_RETRY_MS), [this]() {
+            retry_timer = 0;
+            serve();
+        });
+    }
+
+    // Sends a few batches of the current range, runs on the reactor thread
+    void serve() {
+        serving = false;
+
+        if (stopped.load() || next > last) return;
+
+        // Replies sent before the reader matched would be lost
+        if (reply_listener_.matched_.load() == 0) {
+            if (nowMs() < match_deadline) retryLater();
+            else next = last + 1;
+            return;
+        }
+
+        ChatSyncReply reply;
+        reply.sender = username;
+        reply.last = last;
+
+        for (int batch = 0; batch < SYNC_BATCHES_PER_TURN && next <= last; batch++) {
+            reply.messages.clear();
+
+            size_t count = log->read(next, last, SYNC_BATCH_BYTES, reply.messages);
+
+            // The log is gone or broken
+            if (count == 0) {
+                next = last + 1;
+                return;
+            }
+
+            reply.first = next;
+            reply.count = static_cast<uint32_t>(count);
+
+            // The reply window is full, wait for the requester to acknowledge some of it
+            if (writer_->write(&reply) != eprosima::fastdds::dds::RETCODE_OK) {
+                retryLater();
+                return;
+            }
+
+            next += static_cast<uint32_t>(count);
+        }
+
+        if (next <= last) {
+            serving = true;
+            Reactor::get().post([this]() { serve(); });
+        }
+    }
+
+public:
+    SyncReplier(const std::string& topic_name, const std::string& username, OutboxLog* log)
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , subscriber_(nullptr)
+        , req_topic_(nullptr)
+        , rep_topic_(nullptr)
+        , writer_(nullptr)
+        , reader_(nullptr)
+        , topic_name(topic_name)
+        , username(username)
+        , log(log)
+        , next(1)
+        , last(0)
+        , match_deadline(0)
+        , serving(false)
+        , stopped(false)
+        , retry_timer(0)
+        , request_listener_(this)
+    {}
+
+    SyncReplier(const SyncReplier&) = delete;
+    SyncReplier& operator=(const SyncReplier&) = delete;
+
+    ~SyncReplier() {
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+        }
+
+        // Nothing new gets posted once the reader is gone. A serve() already running may still
+        // schedule a retry, so it's cancelled after that one is done, then anything left drains.
+        stopped.store(true);
+        Reactor::get().sync();
+        Reactor::get().cancel(retry_timer.load());
+        Reactor::get().sync();
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+        }
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (req_topic_ != nullptr)
+        {
+            participant_->delete_topic(req_topic_);
+        }
+        if (rep_topic_ != nullptr)
+        {
+            participant_->delete_topic(rep_topic_);
+        }
+    }
+
+    // The participant must outlive this
+    bool init(DomainParticipant* participant)
+    {
+        participant_ = participant;
+
+        req_topic_ = participant_->create_topic(topic_name + "_sync_req", ChatSyncRequest::typeName(), TOPIC_QOS_DEFAULT);
+        rep_topic_ = participant_->create_topic(topic_name + "_sync_rep", ChatSyncReply::typeName(), TOPIC_QOS_DEFAULT);
+
+        if (req_topic_ == nullptr || rep_topic_ == nullptr)
+        {
+            return false;
+        }
+
+        // Only the newest request matters
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = 1;
+
+        // Writes fail straight away when the window is full instead of blocking the reactor
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        writerQos.reliability().max_blocking_time = eprosima::fastdds::dds::Duration_t(0, 0);
+        writerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+        writerQos.resource_limits().max_samples = SYNC_REPLY_WINDOW;
+        writerQos.resource_limits().max_samples_per_instance = SYNC_REPLY_WINDOW;
+        writerQos.resource_limits().allocated_samples = SYNC_REPLY_WINDOW;
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        writer_ = publisher_->create_datawriter(rep_topic_, writerQos, &reply_listener_);
+
+        if (writer_ == nullptr)
+        {
+            return false;
+        }
+
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(req_topic_, readerQos, &request_listener_);
+
+        if (reader_ == nullptr)
+        {
+            return false;
+        }
+
+        return true;
+    }
+};
+
+// Asks the other user for messages this side missed and hands them back in order
+class SyncRequester {
+public:
+    typedef std::function<void()> PeerCallback;
+    typedef std::function<void(uint32_t first, uint32_t last, const std::string& sender, const std::vector<std::string>& messages)> BatchCallback;
+
+private:
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Subscriber* subscriber_;
+    Topic* req_topic_;
+    Topic* rep_topic_;
+    DataWriter* writer_;
+    DataReader* reader_;
+    std::mutex writer_mtx;      // close() can run while a strand task is in request()
+
+    std::string topic_name;
+    PeerCallback on_peer;
+    BatchCallback on_batch;
+
+    class RequestListener : public DataWriterListener
+    {
+    private:
+        SyncRequester* requester_;
+    public:
+        RequestListener(SyncRequester* requester) : requester_(requester) {}
+        ~RequestListener() override {}
+
+        // The other user's replier showed up (they came online or this side did)
+        void on_publication_matched(DataWriter*, const PublicationMatchedStatus& info) override {
+            if (info.current_count_change > 0) requester_->on_peer();
+        }
+    } request_listener_;
+
+    class ReplyListener : public DataReaderListener
+    {
+    private:
+        SyncRequester* requester_;
+        ChatSyncReply reply_;
+    public:
+        ReplyListener(SyncRequester* requester) : requester_(requester) {}
+        ~ReplyListener() override {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&reply_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (!info.valid_data) continue;
+
+                requester_->on_batch(reply_.first, reply_.last, reply_.sender, reply_.messages);
+            }
+        }
+    } reply_listener_;
+
+public:
+    // on_peer runs when the other user can be asked, on_batch for every reply. Both run on Fast DDS threads.
+    SyncRequester(const std::string& topic_name, PeerCallback on_peer, BatchCallback on_batch)
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , subscriber_(nullptr)
+        , req_topic_(nullptr)
+        , rep_topic_(nullptr)
+        , writer_(nullptr)
+        , reader_(nullptr)
+        , topic_name(topic_name)
+        , on_peer(on_peer)
+        , on_batch(on_batch)
+        , request_listener_(this)
+        , reply_listener_(this)
+    {}
+
+    SyncRequester(const SyncRequester&) = delete;
+    SyncRequester& operator=(const SyncRequester&) = delete;
+
+    ~SyncRequester() {
+        close();
+
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (req_topic_ != nullptr)
+        {
+            participant_->delete_topic(req_topic_);
+        }
+        if (rep_topic_ != nullptr)
+        {
+            participant_->delete_topic(rep_topic_);
+        }
+    }
+
+    // Stops the callbacks, request() does nothing afterwards. Lets the owner wait for
+    // work the callbacks started before this object goes away.
+    void close() {
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+            reader_ = nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(writer_mtx);
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+            writer_ = nullptr;
+        }
+    }
+
+    // The participant must outlive this
+    bool init(DomainParticipant* participant)
+    {
+        participant_ = participant;
+
+        req_topic_ = participant_->create_topic(topic_name + "_sync_req", ChatSyncRequest::typeName(), TOPIC_QOS_DEFAULT);
+        rep_topic_ = participant_->create_topic(topic_name + "_sync_rep", ChatSyncReply::typeName(), TOPIC_QOS_DEFAULT);
+
+        if (req_topic_ == nullptr || rep_topic_ == nullptr)
+        {
+            return false;
+        }
+
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        writerQos.history().depth = 1;
+
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        readerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(rep_topic_, readerQos, &reply_listener_);
+
+        if (reader_ == nullptr)
+        {
+            return false;
+        }
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        writer_ = publisher_->create_datawriter(req_topic_, writerQos, &request_listener_);
+
+        if (writer_ == nullptr)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // Asks for everything after have, up to upto (0 for everything there is)
+    void request(uint32_t have, uint32_t upto = 0) {
+        std::lock_guard<std::mutex> lock(writer_mtx);
+
+        if (writer_ == nullptr) return;
+
+        ChatSyncRequest request;
+        request.have = have;
+        request.upto = upto;
+        writer_->write(&request);
+    }
+};
+
+#endif
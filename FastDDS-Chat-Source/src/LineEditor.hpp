@@ -0,0 +1,204 @@
+/**
+ * @file LineEditor.hpp
+ */
+
+#ifndef LINEEDITOR_H
+#define LINEEDITOR_H
+
+#include "ConsoleWriter.hpp"
+#include "TerminalInput.hpp"
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+// How long readLine() waits for a key before checking whether it should give up
+const int INPUT_POLL_MS = 100;
+
+// Reads chat input a key at a time with the terminal in raw mode. The line being typed lives
+// in ConsoleWriter's InputLine, so incoming messages are printed above it and only that one line
+// is redrawn. Keys are echoed by redrawing just what changed (one character, or the rest of the
+// line after the cursor). When stdin isn't a terminal it falls back to std::getline.
+// Keys: left/right, home/end (or Ctrl-A/Ctrl-E), backspace, delete, Ctrl-U clears the line.
+class LineEditor {
+public:
+    enum Result {
+        LINE,           // line holds what was typed
+        CLOSED,         // End of input
+        STOPPED,        // keep_going returned false
+    };
+
+private:
+    TerminalInput terminal;
+
+    static bool isContinuation(char byte) {
+        return (static_cast<unsigned char>(byte) & 0xc0) == 0x80;
+    }
+
+    // Start of the character before / after cursor, so UTF-8 characters move and delete as one
+    static size_t previousChar(const std::string& text, size_t cursor) {
+        if (cursor == 0) return 0;
+
+        do {
+            cursor--;
+        } while (cursor > 0 && isContinuation(text[cursor]));
+
+        return cursor;
+    }
+
+    static size_t nextChar(const std::string& text, size_t cursor) {
+        if (cursor >= text.size()) return text.size();
+
+        do {
+            cursor++;
+        } while (cursor < text.size() && isContinuation(text[cursor]));
+
+        return cursor;
+    }
+
+public:
+    // Applies one key to the input line, appends the redraw to out. Returns true on Enter.
+    // SplitView uses it too, it only keeps the text and cursor.
+    static bool applyKey(TerminalKey key, const std::string& chars, InputLine& input, std::string& out) {
+        std::string& text = input.text;
+
+        switch (key) {
+        case KEY_CHAR: {
+            text.insert(input.cursor, chars);
+            input.cursor += chars.size();
+
+            // Typing at the end only needs the new character
+            out += chars;
+
+            if (input.cursor < text.size()) {
+                out += text.substr(input.cursor);
+                out += "\033[" + std::to_string(input.columnsAfterCursor()) + "D";
+            }
+            break;
+        }
+        case KEY_BACKSPACE: {
+            if (input.cursor == 0) break;
+
+            size_t start = previousChar(text, input.cursor);
+            text.erase(start, input.cursor - start);
+            input.cursor = start;
+
+            // Step back, draw the rest of the line one to the left, blank the old last column
+            out += "\b" + text.substr(input.cursor) + " ";
+            out += "\033[" + std::to_string(input.columnsAfterCursor() + 1) + "D";
+            break;
+        }
+        case KEY_DELETE: {
+            if (input.cursor >= text.size()) break;
+
+            text.erase(input.cursor, nextChar(text, input.cursor) - input.cursor);
+
+            out += text.substr(input.cursor) + " ";
+            out += "\033[" + std::to_string(input.columnsAfterCursor() + 1) + "D";
+            break;
+        }
+        case KEY_LEFT:
+            if (input.cursor == 0) break;
+
+            input.cursor = previousChar(text, input.cursor);
+            out += "\033[D";
+            break;
+        case KEY_RIGHT:
+            if (input.cursor >= text.size()) break;
+
+            input.cursor = nextChar(text, input.cursor);
+            out += "\033[C";
+            break;
+        case KEY_HOME:
+        case KEY_END:
+        case KEY_KILL_LINE:
+            if (key == KEY_KILL_LINE) text.clear();
+            input.cursor = key == KEY_END ? text.size() : 0;
+
+            out += "\r\033[K" + input.render();
+            break;
+        case KEY_ENTER:
+            // The typed line stays on screen like it would in a normal terminal
+            out += "\r\n";
+            return true;
+        default:
+            break;
+        }
+
+        return false;
+    }
+
+    // The terminal is in raw mode until the editor is destroyed
+    LineEditor() {}
+
+    LineEditor(const LineEditor&) = delete;
+    LineEditor& operator=(const LineEditor&) = delete;
+
+    // False when input is piped in, there's no prompt or key hooks then
+    bool isRaw() const {
+        return terminal.isRaw();
+    }
+
+    // Reads one line. keep_going is checked every INPUT_POLL_MS, on_key runs for every key that changes the line.
+    Result readLine(const std::string& prompt, std::string& line,
+        const std::function<bool()>& keep_going, const std::function<void()>& on_key) {
+        if (!terminal.isRaw()) {
+            if (!keep_going()) return STOPPED;
+            return std::getline(std::cin, line) ? LINE : CLOSED;
+        }
+
+        ConsoleWriter::get().editInput([&prompt](InputLine& input, std::string& out) {
+            input.active = true;
+            input.prompt = prompt;
+            input.text.clear();
+            input.cursor = 0;
+            out += "\r\033[K" + input.render();
+        });
+
+        Result result = STOPPED;
+
+        while (keep_going()) {
+            std::string chars;
+            TerminalKey key = terminal.readKey(chars, INPUT_POLL_MS);
+
+            if (key == KEY_NONE) continue;
+
+            if (key == KEY_EOF) {
+                result = CLOSED;
+                break;
+            }
+
+            bool done = false;
+
+            ConsoleWriter::get().editInput([&](InputLine& input, std::string& out) {
+                done = applyKey(key, chars, input, out);
+
+                if (done) {
+                    line = input.text;
+                    input.active = false;
+                }
+            });
+
+            if (done) {
+                result = LINE;
+                break;
+            }
+
+            if (key == KEY_CHAR || key == KEY_BACKSPACE || key == KEY_DELETE || key == KEY_KILL_LINE) {
+                on_key();
+            }
+        }
+
+        // Gave up halfway through a line, take the prompt off the screen
+        if (result != LINE) {
+            ConsoleWriter::get().editInput([](InputLine& input, std::string& out) {
+                input.active = false;
+                out += "\r\033[K";
+            });
+        }
+
+        return result;
+    }
+};
+
+#endif
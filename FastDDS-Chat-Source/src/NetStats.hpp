@@ -0,0 +1,372 @@
+/**
+ * @file NetStats.hpp
+ */
+
+#ifndef NETSTATS_H
+#define NETSTATS_H
+
+#include "ChatParticipant.hpp"
+#include "NetStatsTypes.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/topic/TypeSupport.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// RTPS-level counters of one contact's chat endpoints, summed over its writers and readers
+struct ContactNetStats {
+    uint64_t data;              // DATA submessages sent
+    uint64_t resent;            // DATA sent again after a NACK or heartbeat
+    uint64_t heartbeats;        // Sent by the writers
+    uint64_t gaps;              // Sent by the writers for messages the reader won't get
+    uint64_t acknacks;          // Sent by the readers, each one past the first few means something was missing
+    uint64_t nackfrags;         // Sent by the readers for missing fragments of large messages
+    uint64_t latency_samples;   // Messages received with a latency
+    double latency_sum_ms;
+    double latency_max_ms;
+
+    ContactNetStats()
+        : data(0), resent(0), heartbeats(0), gaps(0), acknacks(0), nackfrags(0)
+        , latency_samples(0), latency_sum_ms(0), latency_max_ms(0) {}
+
+    // Resent DATA as a percentage of everything sent, the first sign of a lossy link
+    double resentPercent() const {
+        return data == 0 ? 0 : 100.0 * resent / data;
+    }
+
+    double latencyAvgMs() const {
+        return latency_samples == 0 ? 0 : latency_sum_ms / latency_samples;
+    }
+};
+
+// Collects the Fast DDS statistics of this process's own chat endpoints and adds them up per
+// contact. The statistics DataWriters are created in the shared participant when the chat is
+// built with FASTDDS_CHAT_STATISTICS; this reads them back locally, so no monitor is needed.
+// Statistics of endpoints that aren't tracked (presence, sync, receipts) are ignored.
+class NetStats {
+private:
+    enum Counter { DATA, RESENT, HEARTBEATS, GAPS, ACKNACKS, NACKFRAGS, COUNTERS };
+
+    // Latest totals of one endpoint and the contact it belongs to
+    struct Endpoint {
+        std::string contact;
+        uint64_t counts[COUNTERS];
+        uint64_t latency_samples;
+        double latency_sum_ms;
+        double latency_max_ms;
+
+        Endpoint() : latency_samples(0), latency_sum_ms(0), latency_max_ms(0) {
+            std::fill(counts, counts + COUNTERS, 0);
+        }
+    };
+
+    DomainParticipant* participant_;
+    Subscriber* subscriber_;
+    std::vector<Topic*> topics_;
+    std::vector<DataReader*> readers_;
+
+    std::mutex mtx;
+    std::map<std::string, Endpoint> endpoints;      // By guidKey()
+
+    class CounterListener : public DataReaderListener
+    {
+    private:
+        NetStats* stats_;
+        Counter counter_;
+        StatisticsEntityCount sample_;
+    public:
+        CounterListener(NetStats* stats, Counter counter) : stats_(stats), counter_(counter) {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&sample_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data) stats_->updateCount(sample_, counter_);
+            }
+        }
+    };
+
+    class LatencyListener : public DataReaderListener
+    {
+    private:
+        NetStats* stats_;
+        StatisticsWriterReaderData sample_;
+    public:
+        LatencyListener(NetStats* stats) : stats_(stats) {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&sample_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data) stats_->updateLatency(sample_);
+            }
+        }
+    };
+
+    CounterListener data_listener_;
+    CounterListener resent_listener_;
+    CounterListener heartbeat_listener_;
+    CounterListener gap_listener_;
+    CounterListener acknack_listener_;
+    CounterListener nackfrag_listener_;
+    LatencyListener latency_listener_;
+
+    NetStats()
+        : participant_(nullptr)
+        , subscriber_(nullptr)
+        , data_listener_(this, DATA)
+        , resent_listener_(this, RESENT)
+        , heartbeat_listener_(this, HEARTBEATS)
+        , gap_listener_(this, GAPS)
+        , acknack_listener_(this, ACKNACKS)
+        , nackfrag_listener_(this, NACKFRAGS)
+        , latency_listener_(this)
+    {}
+
+    void updateCount(const StatisticsEntityCount& sample, Counter counter) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::map<std::string, Endpoint>::iterator it = endpoints.find(std::string(reinterpret_cast<const char*>(sample.guid), 16));
+
+        if (it != endpoints.end()) it->second.counts[counter] = sample.count;
+    }
+
+    // Reported by our reader for every message it got, from the source timestamp, so it
+    // includes any difference between the two machines' clocks
+    void updateLatency(const StatisticsWriterReaderData& sample) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::map<std::string, Endpoint>::iterator it = endpoints.find(std::string(reinterpret_cast<const char*>(sample.reader_guid), 16));
+
+        if (it == endpoints.end()) return;
+
+        double ms = sample.data / 1000000.0;
+        it->second.latency_samples++;
+        it->second.latency_sum_ms += ms;
+        it->second.latency_max_ms = std::max(it->second.latency_max_ms, ms);
+    }
+
+    bool addReader(const std::string& topic_name, const std::string& type_name, DataReaderListener* listener) {
+        Topic* topic = participant_->create_topic(topic_name, type_name, TOPIC_QOS_DEFAULT);
+
+        if (topic == nullptr)
+        {
+            return false;
+        }
+
+        topics_.push_back(topic);
+
+        // Only the latest total of each endpoint matters
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = 1;
+
+        DataReader* reader = subscriber_->create_datareader(topic, readerQos, listener);
+
+        if (reader == nullptr)
+        {
+            return false;
+        }
+
+        readers_.push_back(reader);
+        return true;
+    }
+
+    ContactNetStats sum(const std::string& contact) {
+        ContactNetStats stats;
+
+        for (std::map<std::string, Endpoint>::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+            const Endpoint& endpoint = it->second;
+            if (endpoint.contact != contact) continue;
+
+            stats.data += endpoint.counts[DATA];
+            stats.resent += endpoint.counts[RESENT];
+            stats.heartbeats += endpoint.counts[HEARTBEATS];
+            stats.gaps += endpoint.counts[GAPS];
+            stats.acknacks += endpoint.counts[ACKNACKS];
+            stats.nackfrags += endpoint.counts[NACKFRAGS];
+            stats.latency_samples += endpoint.latency_samples;
+            stats.latency_sum_ms += endpoint.latency_sum_ms;
+            stats.latency_max_ms = std::max(stats.latency_max_ms, endpoint.latency_max_ms);
+        }
+
+        return stats;
+    }
+
+public:
+    NetStats(const NetStats&) = delete;
+    NetStats& operator=(const NetStats&) = delete;
+
+    ~NetStats() {
+        shutdown();
+    }
+
+    static NetStats& get() {
+        static NetStats stats;
+        return stats;
+    }
+
+    // False when the chat was built without FASTDDS_CHAT_STATISTICS, nothing is collected then
+    static bool available() {
+#ifdef FASTDDS_CHAT_STATISTICS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Starts reading the statistics topics, does nothing if they aren't available
+    bool init()
+    {
+        if (!available()) return true;
+
+        participant_ = ChatParticipant::acquire();
+
+        if (participant_ == nullptr)
+        {
+            return false;
+        }
+
+        subscriber_ = participant_->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        TypeSupport count_type(new StatisticsPubSubType<StatisticsEntityCount>());
+        TypeSupport latency_type(new StatisticsPubSubType<StatisticsWriterReaderData>());
+        count_type.register_type(participant_);
+        latency_type.register_type(participant_);
+
+        std::string count_name = StatisticsEntityCount::typeName();
+        std::string latency_name = StatisticsWriterReaderData::typeName();
+
+        return addReader(STATISTICS_DATA_COUNT_TOPIC, count_name, &data_listener_)
+            && addReader(STATISTICS_RESENT_DATAS_TOPIC, count_name, &resent_listener_)
+            && addReader(STATISTICS_HEARTBEAT_COUNT_TOPIC, count_name, &heartbeat_listener_)
+            && addReader(STATISTICS_GAP_COUNT_TOPIC, count_name, &gap_listener_)
+            && addReader(STATISTICS_ACKNACK_COUNT_TOPIC, count_name, &acknack_listener_)
+            && addReader(STATISTICS_NACKFRAG_COUNT_TOPIC, count_name, &nackfrag_listener_)
+            && addReader(STATISTICS_HISTORY_LATENCY_TOPIC, latency_name, &latency_listener_);
+    }
+
+    // Counts the statistics of these endpoints towards the contact from now on
+    void track(const std::string& contact, const std::vector<eprosima::fastdds::rtps::GUID_t>& guids) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (const eprosima::fastdds::rtps::GUID_t& guid : guids) {
+            endpoints[guidKey(guid)].contact = contact;
+        }
+    }
+
+    // The contact was removed, its endpoints are gone
+    void untrack(const std::string& contact) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (std::map<std::string, Endpoint>::iterator it = endpoints.begin(); it != endpoints.end();) {
+            if (it->second.contact == contact) it = endpoints.erase(it);
+            else ++it;
+        }
+    }
+
+    ContactNetStats summary(const std::string& contact) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return sum(contact);
+    }
+
+    // One line for the chat window
+    std::string describe(const std::string& contact) {
+        ContactNetStats stats = summary(contact);
+        char latency[64];
+        std::snprintf(latency, sizeof(latency), "%.2f ms average, %.2f ms max", stats.latencyAvgMs(), stats.latency_max_ms);
+        char resent[16];
+        std::snprintf(resent, sizeof(resent), "%.1f%%", stats.resentPercent());
+
+        return "Sent " + std::to_string(stats.data) + " DATA, resent " + std::to_string(stats.resent) + " (" + resent + ")"
+            + ", heartbeats " + std::to_string(stats.heartbeats) + ", gaps " + std::to_string(stats.gaps)
+            + ". Sent " + std::to_string(stats.acknacks) + " ACKNACKs, " + std::to_string(stats.nackfrags) + " NACKFRAGs"
+            + ". Latency " + latency + " over " + std::to_string(stats.latency_samples) + " messages.";
+    }
+
+    // Writes every tracked contact as CSV, through a temporary file like the contact list
+    bool exportCsv(const std::string& filename) {
+        std::vector<std::string> contacts;
+        std::vector<ContactNetStats> rows;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (std::map<std::string, Endpoint>::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+                if (std::find(contacts.begin(), contacts.end(), it->second.contact) == contacts.end()) {
+                    contacts.push_back(it->second.contact);
+                }
+            }
+
+            std::sort(contacts.begin(), contacts.end());
+
+            for (const std::string& contact : contacts) {
+                rows.push_back(sum(contact));
+            }
+        }
+
+        std::string temp_file = filename + ".tmp";
+        {
+            std::ofstream out(temp_file);
+            if (!out) return false;
+
+            out << "contact,data,resent,resent_percent,heartbeats,gaps,acknacks,nackfrags,latency_samples,latency_avg_ms,latency_max_ms\n";
+
+            for (size_t i = 0; i < contacts.size(); i++) {
+                const ContactNetStats& stats = rows[i];
+
+                out << contacts[i] << ',' << stats.data << ',' << stats.resent << ',' << stats.resentPercent() << ','
+                    << stats.heartbeats << ',' << stats.gaps << ',' << stats.acknacks << ',' << stats.nackfrags << ','
+                    << stats.latency_samples << ',' << stats.latencyAvgMs() << ',' << stats.latency_max_ms << '\n';
+            }
+
+            if (!out) return false;
+        }
+
+        std::remove(filename.c_str());
+        return std::rename(temp_file.c_str(), filename.c_str()) == 0;
+    }
+
+    void shutdown() {
+        if (participant_ == nullptr) return;
+
+        for (DataReader* reader : readers_) {
+            subscriber_->delete_datareader(reader);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        for (Topic* topic : topics_) {
+            participant_->delete_topic(topic);
+        }
+
+        readers_.clear();
+        topics_.clear();
+        subscriber_ = nullptr;
+        participant_ = nullptr;
+
+        ChatParticipant::release();
+    }
+};
+
+#endif
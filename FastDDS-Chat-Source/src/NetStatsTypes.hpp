@@ -0,0 +1,284 @@
+/**
+ * @file NetStatsTypes.hpp
+ */
+
+#ifndef NETSTATSTYPES_H
+#define NETSTATSTYPES_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fastdds/dds/domain/qos/DomainParticipantQos.hpp>
+#include <fastdds/dds/topic/TopicDataType.hpp>
+#include <fastdds/rtps/common/Guid.hpp>
+#include <fastdds/rtps/common/InstanceHandle.hpp>
+#include <fastdds/rtps/common/SerializedPayload.hpp>
+#include <fastdds/utils/md5.hpp>
+
+// Statistics topics the chat reads, named as in Fast DDS's statistics/topic_names.hpp.
+// Counts are totals since the endpoint was created, latencies are per message in nanoseconds.
+const std::string STATISTICS_RESENT_DATAS_TOPIC = "_fastdds_statistics_resent_datas";
+const std::string STATISTICS_HEARTBEAT_COUNT_TOPIC = "_fastdds_statistics_heartbeat_count";
+const std::string STATISTICS_ACKNACK_COUNT_TOPIC = "_fastdds_statistics_acknack_count";
+const std::string STATISTICS_NACKFRAG_COUNT_TOPIC = "_fastdds_statistics_nackfrag_count";
+const std::string STATISTICS_GAP_COUNT_TOPIC = "_fastdds_statistics_gap_count";
+const std::string STATISTICS_DATA_COUNT_TOPIC = "_fastdds_statistics_data_count";
+const std::string STATISTICS_HISTORY_LATENCY_TOPIC = "_fastdds_statistics_history2history_latency";
+
+// Turns on the statistics DataWriters for those topics. Only has an effect when Fast DDS
+// itself was built with FASTDDS_STATISTICS.
+inline void enableStatisticsWriters(eprosima::fastdds::dds::DomainParticipantQos& participantQos) {
+    participantQos.properties().properties().emplace_back("fastdds.statistics",
+        "RESENT_DATAS_TOPIC;HEARTBEAT_COUNT_TOPIC;ACKNACK_COUNT_TOPIC;NACKFRAG_COUNT_TOPIC;"
+        "GAP_COUNT_TOPIC;DATA_COUNT_TOPIC;HISTORY_LATENCY_TOPIC");
+}
+
+// 12 byte prefix and 4 byte entity id, as a map key
+inline std::string guidKey(const eprosima::fastdds::rtps::GUID_t& guid) {
+    return std::string(reinterpret_cast<const char*>(guid.guidPrefix.value), 12)
+        + std::string(reinterpret_cast<const char*>(guid.entityId.value), 4);
+}
+
+// Reads the CDR the statistics writers send: XCDRv1, or XCDRv2 final or appendable, either endianness.
+// Appendable structs have a DHEADER (their length) in front; whether the nested GUID structs have
+// one too depends on how Fast DDS generated them, so the caller tries with and without.
+class StatisticsCdrReader {
+private:
+    const unsigned char* in;
+    size_t pos;
+    size_t end;
+    bool little;
+    bool xcdr2;
+    bool delimited;
+    bool nested_headers;
+
+    bool align(size_t size) {
+        // XCDRv2 never aligns to more than 4
+        if (xcdr2 && size > 4) size = 4;
+
+        pos = (pos + size - 1) & ~(size - 1);
+        return pos <= end;
+    }
+
+    bool u32(uint32_t& value) {
+        if (!align(4) || end - pos < 4) return false;
+
+        const unsigned char* p = in + pos;
+        value = little
+            ? (static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24))
+            : (static_cast<uint32_t>(p[3]) | (static_cast<uint32_t>(p[2]) << 8) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[0]) << 24));
+        pos += 4;
+        return true;
+    }
+
+public:
+    StatisticsCdrReader(const eprosima::fastdds::rtps::SerializedPayload_t& payload, bool nested_headers)
+        : in(payload.data + 4)
+        , pos(0)
+        , end(payload.length >= 4 ? payload.length - 4 : 0)
+        , little(false)
+        , xcdr2(false)
+        , delimited(false)
+        , nested_headers(nested_headers)
+    {}
+
+    // Encapsulation header, then the outer DHEADER if there is one
+    bool begin() {
+        if (end == 0) return false;
+
+        uint16_t encapsulation = static_cast<uint16_t>((in[-4] << 8) | in[-3]);
+
+        // PL_CDR and PL_CDR2 (mutable types) aren't something the statistics writers send
+        switch (encapsulation) {
+            case 0x0000: case 0x0001: break;
+            case 0x0006: case 0x0007: xcdr2 = true; break;
+            case 0x0008: case 0x0009: xcdr2 = true; delimited = true; break;
+            default: return false;
+        }
+
+        little = (encapsulation & 1) != 0;
+        return structHeader(true);
+    }
+
+    // Skips the DHEADER of a struct, checking it fits
+    bool structHeader(bool outer = false) {
+        if (!delimited || (!outer && !nested_headers)) return true;
+
+        uint32_t length;
+        if (!u32(length) || length > end - pos) return false;
+
+        if (outer) end = pos + length;
+        return true;
+    }
+
+    // Everything up to the outer DHEADER's end was read
+    bool atEnd() const {
+        return pos == end;
+    }
+
+    bool octets(unsigned char* out, size_t count) {
+        if (end - pos < count) return false;
+
+        std::memcpy(out, in + pos, count);
+        pos += count;
+        return true;
+    }
+
+    // GUID_s { GuidPrefix_s { octet value[12] }; EntityId_s { octet value[4] } }
+    bool guid(unsigned char* out) {
+        return structHeader() && structHeader() && octets(out, 12) && structHeader() && octets(out + 12, 4);
+    }
+
+    bool u64(uint64_t& value) {
+        uint32_t low, high;
+
+        if (!align(8)) return false;
+        if (!(little ? (u32(low) && u32(high)) : (u32(high) && u32(low)))) return false;
+
+        value = (static_cast<uint64_t>(high) << 32) | low;
+        return true;
+    }
+
+    bool f32(float& value) {
+        uint32_t bits;
+        if (!u32(bits)) return false;
+
+        std::memcpy(&value, &bits, sizeof(value));
+        return true;
+    }
+};
+
+// eprosima::fastdds::statistics::EntityCount, keyed on the endpoint
+struct StatisticsEntityCount {
+    static const char* typeName() { return "eprosima::fastdds::statistics::EntityCount"; }
+    static const size_t KEY_SIZE = 16;
+
+    unsigned char guid[16];
+    uint64_t count;
+
+    bool read(StatisticsCdrReader& cdr) {
+        return cdr.guid(guid) && cdr.u64(count);
+    }
+
+    void key(unsigned char* out) const {
+        std::memcpy(out, guid, 16);
+    }
+};
+
+// eprosima::fastdds::statistics::WriterReaderData, keyed on the writer and the reader
+struct StatisticsWriterReaderData {
+    static const char* typeName() { return "eprosima::fastdds::statistics::WriterReaderData"; }
+    static const size_t KEY_SIZE = 32;
+
+    unsigned char writer_guid[16];
+    unsigned char reader_guid[16];
+    float data;
+
+    bool read(StatisticsCdrReader& cdr) {
+        return cdr.guid(writer_guid) && cdr.guid(reader_guid) && cdr.f32(data);
+    }
+
+    void key(unsigned char* out) const {
+        std::memcpy(out, writer_guid, 16);
+        std::memcpy(out + 16, reader_guid, 16);
+    }
+};
+
+// Read-only type support for one of the statistics samples above. It has no TypeObject, so it
+// matches the statistics writers by type name; the chat never writes these.
+template<class Sample>
+class StatisticsPubSubType : public eprosima::fastdds::dds::TopicDataType
+{
+private:
+    eprosima::fastdds::MD5 md5_;
+
+public:
+    typedef Sample type;
+
+    StatisticsPubSubType()
+    {
+        set_name(Sample::typeName());
+        max_serialized_type_size = 128;
+        is_compute_key_provided = true;
+    }
+
+    ~StatisticsPubSubType() override {}
+
+    bool serialize(
+            const void* const,
+            eprosima::fastdds::rtps::SerializedPayload_t&,
+            eprosima::fastdds::dds::DataRepresentationId_t) override
+    {
+        return false;
+    }
+
+    bool deserialize(
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            void* data) override
+    {
+        Sample* sample = static_cast<Sample*>(data);
+
+        // Nested DHEADERs read from a payload without them wouldn't end in the right place
+        StatisticsCdrReader nested(payload, true);
+        if (nested.begin() && sample->read(nested) && nested.atEnd()) return true;
+
+        StatisticsCdrReader flat(payload, false);
+        return flat.begin() && sample->read(flat);
+    }
+
+    uint32_t calculate_serialized_size(
+            const void* const,
+            eprosima::fastdds::dds::DataRepresentationId_t) override
+    {
+        return max_serialized_type_size;
+    }
+
+    bool compute_key(
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            eprosima::fastdds::rtps::InstanceHandle_t& handle,
+            bool force_md5 = false) override
+    {
+        Sample sample;
+        return deserialize(payload, &sample) && compute_key(&sample, handle, force_md5);
+    }
+
+    // The key members are all octets, so their big endian CDR is just the bytes
+    bool compute_key(
+            const void* const data,
+            eprosima::fastdds::rtps::InstanceHandle_t& handle,
+            bool force_md5 = false) override
+    {
+        unsigned char key[Sample::KEY_SIZE];
+        static_cast<const Sample*>(data)->key(key);
+
+        if (force_md5 || Sample::KEY_SIZE > 16) {
+            md5_.init();
+            md5_.update(key, static_cast<unsigned int>(Sample::KEY_SIZE));
+            md5_.finalize();
+            std::memcpy(handle.value, md5_.digest, 16);
+        }
+        else {
+            std::memset(handle.value, 0, 16);
+            std::memcpy(handle.value, key, Sample::KEY_SIZE);
+        }
+
+        return true;
+    }
+
+    void* create_data() override
+    {
+        return reinterpret_cast<void*>(new Sample());
+    }
+
+    void delete_data(void* data) override
+    {
+        delete(reinterpret_cast<Sample*>(data));
+    }
+
+    void register_type_object_representation() override
+    {
+    }
+};
+
+#endif
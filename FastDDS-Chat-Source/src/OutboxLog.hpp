@@ -0,0 +1,324 @@
+/**
+ * @file OutboxLog.hpp
+ */
+
+#ifndef OUTBOXLOG_H
+#define OUTBOXLOG_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Every this many records the file offset is remembered, the rest are found by skipping forward
+const size_t OUTBOX_INDEX_STRIDE = 64;
+
+// Past this size a segment is closed and the next one started
+const uint64_t OUTBOX_SEGMENT_BYTES = 2 * 1024 * 1024;
+
+// Segment files kept. Once they're all full the oldest is emptied and reused, so the log stays under about 8 MB.
+const size_t OUTBOX_SEGMENTS = 4;
+
+// Every message published on one topic, kept on disk so a peer that was away can be
+// sent what it missed, and so indexes keep counting up after a restart.
+// The log is split over segment files <filename>.0 to <filename>.3 used in turn; dropping the
+// oldest messages is just emptying the oldest segment, so peers away for longer than the
+// four hold only get the newest messages.
+// Records are [index u32][length u32][message bytes], little endian. Only every
+// OUTBOX_INDEX_STRIDE-th record's offset is kept in memory. append() doesn't flush,
+// the owner calls flush() once per batch of messages.
+class OutboxLog {
+private:
+    struct Segment {
+        size_t slot;                    // The file is <filename>.<slot>
+        uint32_t first_index;
+        uint32_t count;                 // Records in the file
+        uint64_t end_offset;            // Where the next record goes
+        std::vector<uint64_t> index;    // index[i] is the record of index first_index + i * OUTBOX_INDEX_STRIDE
+
+        Segment(size_t slot) : slot(slot), first_index(1), count(0), end_offset(0) {}
+    };
+
+    std::mutex mtx;
+    std::fstream file;                  // The newest segment, the only one written to
+    std::string filename;
+    std::deque<Segment> segments;       // Oldest first, the newest is never full
+    bool dirty;                         // Appended to since the last flush()
+
+    static void putU32(char* out, uint32_t value) {
+        out[0] = static_cast<char>(value & 0xff);
+        out[1] = static_cast<char>((value >> 8) & 0xff);
+        out[2] = static_cast<char>((value >> 16) & 0xff);
+        out[3] = static_cast<char>((value >> 24) & 0xff);
+    }
+
+    static uint32_t getU32(const char* in) {
+        return static_cast<uint32_t>(static_cast<unsigned char>(in[0]))
+            | (static_cast<uint32_t>(static_cast<unsigned char>(in[1])) << 8)
+            | (static_cast<uint32_t>(static_cast<unsigned char>(in[2])) << 16)
+            | (static_cast<uint32_t>(static_cast<unsigned char>(in[3])) << 24);
+    }
+
+    static std::string segmentName(const std::string& filename, size_t slot) {
+        return filename + "." + std::to_string(slot);
+    }
+
+    uint32_t totalCount() const {
+        uint32_t total = 0;
+        for (const Segment& segment : segments) total += segment.count;
+        return total;
+    }
+
+    // Remembers where the record just counted starts, if it is on a stride
+    static void indexRecord(Segment& segment, uint64_t offset) {
+        if (segment.count % OUTBOX_INDEX_STRIDE == 0) segment.index.push_back(offset);
+        segment.count++;
+    }
+
+    // Builds a segment's index, stops at a record cut off by a crash or anything out of order
+    static void scan(std::istream& in, Segment& segment) {
+        char header[8];
+        uint64_t offset = 0;
+
+        in.seekg(0, std::ios::end);
+        uint64_t size = static_cast<uint64_t>(in.tellg());
+
+        while (offset + sizeof(header) <= size) {
+            in.seekg(offset);
+            if (!in.read(header, sizeof(header))) break;
+
+            uint32_t record_index = getU32(header);
+            uint32_t length = getU32(header + 4);
+
+            if (offset + sizeof(header) + length > size) break;
+            if (segment.count > 0 && record_index != segment.first_index + segment.count) break;
+
+            if (segment.count == 0) segment.first_index = record_index;
+            indexRecord(segment, offset);
+            offset += sizeof(header) + length;
+        }
+
+        in.clear();
+        segment.end_offset = offset;
+    }
+
+    // Finds the segments left by the last run. Only the newest run of consecutive ones is kept.
+    void load() {
+        std::vector<Segment> found;
+
+        for (size_t slot = 0; slot < OUTBOX_SEGMENTS; slot++) {
+            std::ifstream in(segmentName(filename, slot), std::ios::binary);
+            if (!in) continue;
+
+            Segment segment(slot);
+            scan(in, segment);
+            if (segment.count > 0) found.push_back(segment);
+        }
+
+        std::sort(found.begin(), found.end(),
+            [](const Segment& a, const Segment& b) { return a.first_index < b.first_index; });
+
+        segments.clear();
+
+        for (size_t i = found.size(); i > 0; i--) {
+            if (!segments.empty() && found[i - 1].first_index + found[i - 1].count != segments.front().first_index) break;
+            segments.push_front(found[i - 1]);
+        }
+    }
+
+    // Makes the segment after the newest one the one written to, emptying it if it was the oldest.
+    // Keeps writing to the full one if the file can't be opened.
+    void rotate() {
+        size_t slot = (segments.back().slot + 1) % OUTBOX_SEGMENTS;
+        std::fstream next(segmentName(filename, slot), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!next) return;
+
+        file.flush();
+        file = std::move(next);
+
+        if (segments.front().slot == slot) segments.pop_front();
+        segments.push_back(Segment(slot));
+    }
+
+    // Opens the newest segment for writing, creating it if there's none yet
+    bool openNewest() {
+        if (segments.empty()) segments.push_back(Segment(0));
+
+        std::string name = segmentName(filename, segments.back().slot);
+        file.open(name, std::ios::in | std::ios::out | std::ios::binary);
+
+        if (!file) {
+            file.clear();
+            file.open(name, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+
+        return file.is_open();
+    }
+
+public:
+    OutboxLog() : dirty(false) {}
+
+    OutboxLog(const OutboxLog&) = delete;
+    OutboxLog& operator=(const OutboxLog&) = delete;
+
+    // Deletes every segment of a log that isn't open
+    static void remove(const std::string& filename) {
+        for (size_t slot = 0; slot < OUTBOX_SEGMENTS; slot++) {
+            std::remove(segmentName(filename, slot).c_str());
+        }
+    }
+
+    // Opens or creates the log. Returns false if the file can't be used (e.g. no ChatLogs folder).
+    bool open(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        this->filename = filename;
+
+        // A log from before segments becomes the first one
+        std::ifstream single(filename, std::ios::binary);
+        std::ifstream first(segmentName(filename, 0), std::ios::binary);
+
+        if (single && !first) {
+            single.close();
+            std::rename(filename.c_str(), segmentName(filename, 0).c_str());
+        }
+
+        load();
+        return openNewest();
+    }
+
+    bool isOpen() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return file.is_open();
+    }
+
+    // Index of the oldest message still in the log
+    uint32_t firstIndex() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return segments.empty() ? 1 : segments.front().first_index;
+    }
+
+    // Index of the newest message, 0 if there are none
+    uint32_t lastIndex() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        uint32_t total = totalCount();
+        return total == 0 ? 0 : segments.front().first_index + total - 1;
+    }
+
+    // Indexes have to follow on from lastIndex()
+    bool append(uint32_t record_index, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (!file.is_open()) return false;
+
+        uint32_t total = totalCount();
+        if (total > 0 && record_index != segments.front().first_index + total) return false;
+
+        if (segments.back().end_offset >= OUTBOX_SEGMENT_BYTES) rotate();
+
+        Segment& segment = segments.back();
+        char header[8];
+        putU32(header, record_index);
+        putU32(header + 4, static_cast<uint32_t>(message.size()));
+
+        file.seekp(segment.end_offset);
+        file.write(header, sizeof(header));
+        file.write(message.data(), message.size());
+
+        if (!file) {
+            file.clear();
+            return false;
+        }
+
+        if (segment.count == 0) segment.first_index = record_index;
+        indexRecord(segment, segment.end_offset);
+        segment.end_offset += sizeof(header) + message.size();
+
+        dirty = true;
+        return true;
+    }
+
+    // Writes out what append() buffered
+    void flush() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (!dirty) return;
+
+        file.flush();
+        dirty = false;
+    }
+
+    // Reads messages from index "from" up to "to", stopping once max_bytes of text have been read
+    // (at least one message is always read). Returns how many were added to out.
+    size_t read(uint32_t from, uint32_t to, size_t max_bytes, std::vector<std::string>& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        size_t added = 0;
+        size_t bytes = 0;
+        char header[8];
+
+        if (!file.is_open()) return 0;
+
+        for (const Segment& segment : segments) {
+            if (from > to) break;
+            if (segment.count == 0 || from < segment.first_index || from - segment.first_index >= segment.count) {
+                // Only the segment holding "from" (and the ones after it) are read
+                if (added == 0) continue;
+                break;
+            }
+
+            std::ifstream older;
+            std::istream* in = &file;
+
+            if (&segment != &segments.back()) {
+                older.open(segmentName(filename, segment.slot), std::ios::binary);
+                if (!older) break;
+                in = &older;
+            }
+
+            uint32_t first = from - segment.first_index;
+            bool full = false;
+
+            in->seekg(segment.index[first / OUTBOX_INDEX_STRIDE]);
+
+            for (uint32_t i = first - first % OUTBOX_INDEX_STRIDE; i < segment.count && segment.first_index + i <= to; i++) {
+                if (!in->read(header, sizeof(header))) break;
+
+                uint32_t length = getU32(header + 4);
+
+                if (i < first) {
+                    in->seekg(length, std::ios::cur);
+                    continue;
+                }
+
+                if (added > 0 && bytes + length > max_bytes) {
+                    full = true;
+                    break;
+                }
+
+                std::string message(length, '\0');
+                if (length > 0 && !in->read(&message[0], length)) break;
+
+                out.push_back(std::move(message));
+                bytes += length;
+                added++;
+                from++;
+            }
+
+            in->clear();
+
+            if (full || from != segment.first_index + segment.count) break;
+        }
+
+        return added;
+    }
+};
+
+#endif
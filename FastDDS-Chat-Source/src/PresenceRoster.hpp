@@ -0,0 +1,240 @@
+/**
+ * @file PresenceRoster.hpp
+ */
+
+#ifndef PRESENCEROSTER_H
+#define PRESENCEROSTER_H
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatConfig.hpp"
+#include "ChatParticipant.hpp"
+#include "QosProfiles.hpp"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Who is online, shared by every contact. Every user has one writer on the
+// presence topic with AUTOMATIC liveliness, so a user that goes away is
+// noticed within the lease duration without any per-contact traffic.
+class PresenceRoster {
+private:
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Subscriber* subscriber_;
+    Topic* topic_;
+    DataWriter* writer_;
+    DataReader* reader_;
+
+    std::mutex mtx;
+    std::unordered_map<std::string, bool> online;                         // Username -> online
+    std::map<eprosima::fastdds::rtps::InstanceHandle_t, std::string> writers;  // Presence writer -> username
+    std::unordered_map<std::string, eprosima::fastdds::rtps::InstanceHandle_t> latest;  // Username -> newest writer (users can restart)
+
+    class RosterListener : public DataReaderListener
+    {
+    private:
+        PresenceRoster* roster_;
+        UserChat announcement_;
+    public:
+        RosterListener(PresenceRoster* roster) : roster_(roster) {}
+        ~RosterListener() override {}
+
+        // Announcements say which user a presence writer belongs to
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&announcement_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data && announcement_.username() != "") {
+                    roster_->setWriter(info.publication_handle, announcement_.username());
+                }
+            }
+        }
+
+        void on_liveliness_changed(DataReader*, const LivelinessChangedStatus& status) override
+        {
+            if (status.alive_count_change > 0) {
+                roster_->setOnline(status.last_publication_handle, true, false);
+            }
+            else if (status.alive_count_change < 0) {
+                // Not counted as "not alive" means the writer was deleted (user exited) rather than lost
+                roster_->setOnline(status.last_publication_handle, false, status.not_alive_count_change == 0);
+            }
+        }
+    } listener_;
+
+    PresenceRoster()
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , subscriber_(nullptr)
+        , topic_(nullptr)
+        , writer_(nullptr)
+        , reader_(nullptr)
+        , listener_(this)
+    {}
+
+    void setWriter(const eprosima::fastdds::rtps::InstanceHandle_t& handle, const std::string& username) {
+        std::lock_guard<std::mutex> lock(mtx);
+        writers[handle] = username;
+        latest[username] = handle;
+        online[username] = true;
+    }
+
+    void setOnline(const eprosima::fastdds::rtps::InstanceHandle_t& handle, bool is_online, bool removed) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::map<eprosima::fastdds::rtps::InstanceHandle_t, std::string>::iterator it = writers.find(handle);
+
+        // Writers that haven't announced yet are picked up in on_data_available
+        if (it == writers.end()) return;
+
+        // An old writer of a user that came back doesn't change anything
+        if (latest[it->second] == handle) {
+            online[it->second] = is_online;
+        }
+
+        if (removed) writers.erase(it);
+    }
+
+public:
+    PresenceRoster(const PresenceRoster&) = delete;
+    PresenceRoster& operator=(const PresenceRoster&) = delete;
+
+    ~PresenceRoster() {
+        shutdown();
+    }
+
+    static PresenceRoster& get() {
+        static PresenceRoster roster;
+        return roster;
+    }
+
+    // Announces this user and starts following everyone else
+    bool init(const std::string& username)
+    {
+        participant_ = ChatParticipant::acquire();
+
+        if (participant_ == nullptr)
+        {
+            return false;
+        }
+
+        topic_ = participant_->create_topic("ChatPresence", "UserChat", TOPIC_QOS_DEFAULT);
+
+        if (topic_ == nullptr)
+        {
+            return false;
+        }
+
+        unsigned int lease_ms = chatConfig().presence_lease_ms;
+
+        // Late joiners still get the announcement, liveliness keeps it fresh
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        writerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+        writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        writerQos.history().depth = 1;
+        writerQos.liveliness().kind = AUTOMATIC_LIVELINESS_QOS;
+        writerQos.liveliness().lease_duration = msToDuration(lease_ms);
+        writerQos.liveliness().announcement_period = msToDuration(lease_ms / 3);
+
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+        readerQos.durability().kind = TRANSIENT_LOCAL_DURABILITY_QOS;
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = 1;
+        readerQos.liveliness().kind = AUTOMATIC_LIVELINESS_QOS;
+        readerQos.liveliness().lease_duration = msToDuration(lease_ms);
+
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(topic_, readerQos, &listener_);
+
+        if (reader_ == nullptr)
+        {
+            return false;
+        }
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        writer_ = publisher_->create_datawriter(topic_, writerQos, nullptr);
+
+        if (writer_ == nullptr)
+        {
+            return false;
+        }
+
+        UserChat announcement;
+        announcement.username(username);
+        announcement.message("online");
+        writer_->write(&announcement);
+
+        return true;
+    }
+
+    void shutdown() {
+        if (participant_ == nullptr) return;
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+        }
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (topic_ != nullptr)
+        {
+            participant_->delete_topic(topic_);
+        }
+
+        writer_ = nullptr;
+        publisher_ = nullptr;
+        reader_ = nullptr;
+        subscriber_ = nullptr;
+        topic_ = nullptr;
+        participant_ = nullptr;
+
+        ChatParticipant::release();
+    }
+
+    bool isOnline(const std::string& username) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::unordered_map<std::string, bool>::iterator it = online.find(username);
+
+        return it != online.end() && it->second;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * @file QosProfiles.hpp
+ */
+
+#ifndef QOSPROFILES_H
+#define QOSPROFILES_H
+
+#include "ChatConfig.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <fastdds/dds/core/ReturnCode.hpp>
+#include <fastdds/dds/domain/DomainParticipantFactory.hpp>
+#include <fastdds/dds/domain/qos/DomainParticipantQos.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/publisher/qos/PublisherQos.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/qos/SubscriberQos.hpp>
+#include <fastdds/rtps/flowcontrol/FlowControllerDescriptor.hpp>
+#include <fastdds/rtps/flowcontrol/FlowControllerSchedulerPolicy.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Keeps the Fast DDS default for a setting in QosProfile
+const int32_t QOS_UNSET = -1;
+
+// Flow controller every asynchronous chat writer sends through, see addChatFlowController()
+const char* const CHAT_FLOW_CONTROLLER = "chat_flow";
+
+// How often a flow_limit controller hands out bytes. Short, so an urgent message never waits long for the next period.
+const uint64_t CHAT_FLOW_PERIOD_MS = 2;
+
+// "fastdds.sfc.priority" of urgent writers: -10 is the highest, writers without it are 10 (the lowest)
+const char* const URGENT_FLOW_PRIORITY = "-10";
+
+// Advertised to the other side and to the network stack of transports that use it
+const uint32_t URGENT_TRANSPORT_PRIORITY = 100;
+
+// Unacknowledged urgent messages per contact, after that /urgent reports the other side is behind
+const int32_t URGENT_SEND_QUEUE = 32;
+
+// Writer/reader settings for one kind of use, picked with qos_profile.
+// Timings are in ms, anything left at QOS_UNSET keeps the Fast DDS default.
+struct QosProfile {
+    const char* name;
+    bool reliable;                          // Readers ask for lost samples too (writers always do)
+    bool keep_all;                          // KEEP_ALL history instead of KEEP_LAST
+    int32_t history_depth;                  // KEEP_LAST depth
+    int32_t max_samples;                    // Resource limit of KEEP_ALL histories
+    bool async;                             // Writes return before the data is sent
+    int32_t heartbeat_period_ms;            // How often writers ask readers what they're missing
+    int32_t nack_response_delay_ms;         // How long writers wait before answering a NACK
+    int32_t nack_supression_ms;             // Ignore NACKs this soon after resending
+    int32_t heartbeat_response_delay_ms;    // How long readers wait before answering a heartbeat
+};
+
+// default:     Fast DDS defaults, what the chat always used (readers are made reliable by send_queue)
+// low-latency: losses are repaired as soon as they're seen
+// bulk:        nothing is overwritten and writes don't wait for the network, for big bursts
+// wan:         long round trips, so losses are found with frequent heartbeats and answered right away
+const QosProfile BUILTIN_QOS_PROFILES[] = {
+    { "default",     false, false, QOS_UNSET, QOS_UNSET, false, QOS_UNSET, QOS_UNSET, QOS_UNSET, QOS_UNSET },
+    { "low-latency", true,  false, 16,        QOS_UNSET, false, 50,        0,         0,         0         },
+    { "bulk",        true,  true,  QOS_UNSET, 10000,     true,  500,       20,        QOS_UNSET, 20        },
+    { "wan",         true,  false, 100,       QOS_UNSET, false, 100,       0,         0,         0         },
+};
+
+inline eprosima::fastdds::dds::Duration_t msToDuration(unsigned int ms) {
+    return eprosima::fastdds::dds::Duration_t(static_cast<int32_t>(ms / 1000), (ms % 1000) * 1000000);
+}
+
+// Builtin profile with this name, nullptr if there isn't one
+inline const QosProfile* findQosProfile(const std::string& name) {
+    for (size_t i = 0; i < sizeof(BUILTIN_QOS_PROFILES) / sizeof(BUILTIN_QOS_PROFILES[0]); i++) {
+        if (name == BUILTIN_QOS_PROFILES[i].name) return &BUILTIN_QOS_PROFILES[i];
+    }
+
+    return nullptr;
+}
+
+// Profile used when the configured name isn't builtin or in the XML file
+inline const QosProfile& fallbackQosProfile(const ChatConfig& config) {
+    const QosProfile* profile = findQosProfile(config.qos_profile);
+
+    if (profile == nullptr) {
+        static std::once_flag warned;
+        std::call_once(warned, [&config]() {
+            std::cerr << "Unknown QoS profile " << config.qos_profile << ", using default." << std::endl;
+        });
+
+        profile = &BUILTIN_QOS_PROFILES[0];
+    }
+
+    return *profile;
+}
+
+// Loads xml_profiles once, before any participant is created. Returns false if the file is bad.
+inline bool loadXmlProfiles(const ChatConfig& config) {
+    static bool loaded = false;
+
+    if (loaded || config.xml_profiles_file.empty()) return true;
+
+    if (DomainParticipantFactory::get_instance()->load_XML_profiles_file(config.xml_profiles_file) != RETCODE_OK) {
+        std::cerr << "Could not load XML profiles from " << config.xml_profiles_file << "." << std::endl;
+        return false;
+    }
+
+    loaded = true;
+    return true;
+}
+
+// Participant settings of an XML participant profile with the configured name, if there is one
+inline void applyQosProfile(DomainParticipantQos& participantQos, const ChatConfig& config) {
+    if (config.xml_profiles_file.empty()) return;
+
+    DomainParticipantFactory::get_instance()->get_participant_qos_from_profile(config.qos_profile, participantQos);
+}
+
+// Every chat Publisher/Subscriber is put in the configured partitions. A writer and reader
+// only match when they share one, so endpoints of other rooms are discovered but ignored.
+inline PublisherQos chatPublisherQos(const ChatConfig& config) {
+    PublisherQos publisherQos = PUBLISHER_QOS_DEFAULT;
+
+    for (const std::string& name : chatPartitions(config)) {
+        publisherQos.partition().push_back(name.c_str());
+    }
+
+    return publisherQos;
+}
+
+inline SubscriberQos chatSubscriberQos(const ChatConfig& config) {
+    SubscriberQos subscriberQos = SUBSCRIBER_QOS_DEFAULT;
+
+    for (const std::string& name : chatPartitions(config)) {
+        subscriberQos.partition().push_back(name.c_str());
+    }
+
+    return subscriberQos;
+}
+
+inline void applyQosProfile(DataWriterQos& writerQos, const Publisher* publisher, const ChatConfig& config) {
+    // An XML data_writer profile with the same name wins
+    if (!config.xml_profiles_file.empty() &&
+        publisher->get_datawriter_qos_from_profile(config.qos_profile, writerQos) == RETCODE_OK) {
+        return;
+    }
+
+    const QosProfile& profile = fallbackQosProfile(config);
+
+    if (profile.keep_all) {
+        writerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+    }
+    if (profile.history_depth != QOS_UNSET) {
+        writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        writerQos.history().depth = profile.history_depth;
+    }
+    if (profile.max_samples != QOS_UNSET) {
+        writerQos.resource_limits().max_samples = profile.max_samples;
+        writerQos.resource_limits().max_samples_per_instance = profile.max_samples;
+    }
+    if (profile.async) {
+        writerQos.publish_mode().kind = ASYNCHRONOUS_PUBLISH_MODE;
+        writerQos.publish_mode().flow_controller_name = CHAT_FLOW_CONTROLLER;
+    }
+    if (profile.heartbeat_period_ms != QOS_UNSET) {
+        writerQos.reliable_writer_qos().times.heartbeat_period = msToDuration(profile.heartbeat_period_ms);
+    }
+    if (profile.nack_response_delay_ms != QOS_UNSET) {
+        writerQos.reliable_writer_qos().times.nack_response_delay = msToDuration(profile.nack_response_delay_ms);
+    }
+    if (profile.nack_supression_ms != QOS_UNSET) {
+        writerQos.reliable_writer_qos().times.nack_supression_duration = msToDuration(profile.nack_supression_ms);
+    }
+}
+
+// Chat writers never block the reactor: a write that doesn't fit fails straight away.
+// At most send_queue unacknowledged messages are kept per contact (KEEP_ALL), so a full queue is
+// reported instead of the oldest message being dropped. send_queue = 0 keeps the profile's
+// history, which for KEEP_LAST overwrites unacknowledged messages and never reports full.
+// Only reliable readers acknowledge anything, so the queue makes both ends reliable whatever
+// the profile (or XML file) says.
+inline void applySendQueue(DataWriterQos& writerQos, const ChatConfig& config) {
+    writerQos.reliability().max_blocking_time = eprosima::fastdds::dds::Duration_t(0, 0);
+
+    if (config.send_queue <= 0) return;
+
+    writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    writerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+    writerQos.resource_limits().max_samples = config.send_queue;
+    writerQos.resource_limits().max_samples_per_instance = config.send_queue;
+    writerQos.resource_limits().allocated_samples = std::min<int32_t>(config.send_queue, 100);
+}
+
+inline void applySendQueue(DataReaderQos& readerQos, const ChatConfig& config) {
+    if (config.send_queue <= 0) return;
+
+    readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+}
+
+// A writer sends in the one representation it offers, so data_representation picks the wire
+// format of chat messages. Readers accept both, which keeps them matching writers of either kind.
+inline void applyDataRepresentation(DataWriterQos& writerQos, const ChatConfig& config) {
+    if (config.data_representation == "xcdr1") {
+        writerQos.representation().m_value.assign(1, XCDR_DATA_REPRESENTATION);
+    }
+    else if (config.data_representation == "xcdr2") {
+        writerQos.representation().m_value.assign(1, XCDR2_DATA_REPRESENTATION);
+    }
+}
+
+inline void applyDataRepresentation(DataReaderQos& readerQos, const ChatConfig& config) {
+    if (config.data_representation.empty()) return;
+
+    readerQos.representation().m_value.clear();
+    readerQos.representation().m_value.push_back(XCDR2_DATA_REPRESENTATION);
+    readerQos.representation().m_value.push_back(XCDR_DATA_REPRESENTATION);
+}
+
+// One HIGH_PRIORITY flow controller for all asynchronous writers of the participant. Whatever
+// is queued in it goes out highest "fastdds.sfc.priority" first, so urgent messages overtake bulk
+// ones. With flow_limit it also caps how fast the writers send together.
+inline void addChatFlowController(DomainParticipantQos& participantQos, const ChatConfig& config) {
+    std::shared_ptr<eprosima::fastdds::rtps::FlowControllerDescriptor> flow(new eprosima::fastdds::rtps::FlowControllerDescriptor());
+    flow->name = CHAT_FLOW_CONTROLLER;
+    flow->scheduler = eprosima::fastdds::rtps::FlowControllerSchedulerPolicy::HIGH_PRIORITY;
+
+    if (config.flow_limit_kbps > 0) {
+        uint64_t bytes = static_cast<uint64_t>(config.flow_limit_kbps) * 1024 * CHAT_FLOW_PERIOD_MS / 1000;
+
+        flow->max_bytes_per_period = static_cast<int32_t>(std::max<uint64_t>(bytes, 1500));
+        flow->period_ms = CHAT_FLOW_PERIOD_MS;
+    }
+
+    participantQos.flow_controllers().push_back(flow);
+}
+
+// Writer of a conversation's priority lane, publish_mode is the normal writer's. Synchronous
+// writes already skip every queue; asynchronous ones go to the same flow controller as the
+// normal writer with the highest priority, so they jump whatever bulk data is queued there.
+// TRANSPORT_PRIORITY and LATENCY_BUDGET are hints (Fast DDS itself doesn't act on them), the
+// flow controller priority is what puts urgent messages first.
+inline void applyUrgentQos(DataWriterQos& writerQos, const PublishModeQosPolicy& publish_mode) {
+    writerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    writerQos.reliability().max_blocking_time = eprosima::fastdds::dds::Duration_t(0, 0);
+    writerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+    writerQos.resource_limits().max_samples = URGENT_SEND_QUEUE;
+    writerQos.resource_limits().max_samples_per_instance = URGENT_SEND_QUEUE;
+    writerQos.resource_limits().allocated_samples = URGENT_SEND_QUEUE;
+    writerQos.latency_budget().duration = eprosima::fastdds::dds::Duration_t(0, 0);
+    writerQos.transport_priority().value = URGENT_TRANSPORT_PRIORITY;
+
+    // Lost urgent messages are noticed and repaired right away
+    writerQos.reliable_writer_qos().times.heartbeat_period = msToDuration(20);
+    writerQos.reliable_writer_qos().times.nack_response_delay = msToDuration(0);
+
+    if (publish_mode.kind == ASYNCHRONOUS_PUBLISH_MODE) {
+        writerQos.publish_mode() = publish_mode;
+        writerQos.properties().properties().emplace_back("fastdds.sfc.priority", URGENT_FLOW_PRIORITY);
+    }
+}
+
+inline void applyUrgentQos(DataReaderQos& readerQos) {
+    readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+    readerQos.history().depth = URGENT_SEND_QUEUE;
+    readerQos.latency_budget().duration = eprosima::fastdds::dds::Duration_t(0, 0);
+    readerQos.reliable_reader_qos().times.heartbeat_response_delay = msToDuration(0);
+}
+
+inline void applyQosProfile(DataReaderQos& readerQos, const Subscriber* subscriber, const ChatConfig& config) {
+    // An XML data_reader profile with the same name wins
+    if (!config.xml_profiles_file.empty() &&
+        subscriber->get_datareader_qos_from_profile(config.qos_profile, readerQos) == RETCODE_OK) {
+        return;
+    }
+
+    const QosProfile& profile = fallbackQosProfile(config);
+
+    if (profile.reliable) {
+        readerQos.reliability().kind = RELIABLE_RELIABILITY_QOS;
+    }
+    if (profile.keep_all) {
+        readerQos.history().kind = KEEP_ALL_HISTORY_QOS;
+    }
+    if (profile.history_depth != QOS_UNSET) {
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = profile.history_depth;
+    }
+    if (profile.max_samples != QOS_UNSET) {
+        readerQos.resource_limits().max_samples = profile.max_samples;
+        readerQos.resource_limits().max_samples_per_instance = profile.max_samples;
+    }
+    if (profile.heartbeat_response_delay_ms != QOS_UNSET) {
+        readerQos.reliable_reader_qos().times.heartbeat_response_delay = msToDuration(profile.heartbeat_response_delay_ms);
+    }
+}
+
+#endif
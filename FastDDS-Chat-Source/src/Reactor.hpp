@@ -0,0 +1,154 @@
+/**
+ * @file Reactor.hpp
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "Trace.hpp"
+
+// One event loop thread shared by every contact. Runs posted tasks (outbound
+// messages) and timers, so the number of threads doesn't grow with contacts.
+class Reactor {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Timer {
+        unsigned long long id;
+        std::chrono::milliseconds period;   // 0 for one-shot timers
+        std::function<void()> fn;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::multimap<Clock::time_point, Timer> timers;
+    unsigned long long next_timer_id;
+    bool running;
+    std::thread worker;
+
+    Reactor() : next_timer_id(1), running(true) {
+        worker = std::thread(&Reactor::run, this);
+    }
+
+    void run() {
+        CHAT_TRACE_THREAD("reactor");
+        std::unique_lock<std::mutex> lock(mtx);
+
+        while (running || !tasks.empty()) {
+            // Due timers go before the next task, so a steady stream of posts can't hold them back
+            if (!timers.empty() && timers.begin()->first <= Clock::now()) {
+                Timer timer = timers.begin()->second;
+                timers.erase(timers.begin());
+
+                // Rescheduled before running, so cancel() from inside fn still finds it
+                if (timer.period.count() > 0) {
+                    timers.insert(std::make_pair(Clock::now() + timer.period, timer));
+                }
+
+                lock.unlock();
+                timer.fn();
+                lock.lock();
+                continue;
+            }
+
+            if (!tasks.empty()) {
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+
+                lock.unlock();
+                task();
+                lock.lock();
+                continue;
+            }
+
+            if (timers.empty()) cv.wait(lock);
+            else cv.wait_until(lock, timers.begin()->first);
+        }
+    }
+
+public:
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    ~Reactor() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running = false;
+        }
+        cv.notify_one();
+
+        if (worker.joinable()) worker.join();
+    }
+
+    static Reactor& get() {
+        static Reactor instance;
+        return instance;
+    }
+
+    // Runs fn on the reactor thread as soon as possible
+    void post(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(fn));
+        }
+        cv.notify_one();
+    }
+
+    // Runs fn after delay, then every period if period isn't 0. Returns an id for cancel()
+    unsigned long long schedule(std::chrono::milliseconds delay, std::function<void()> fn,
+        std::chrono::milliseconds period = std::chrono::milliseconds(0)) {
+        unsigned long long id = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            id = next_timer_id++;
+
+            Timer timer = { id, period, std::move(fn) };
+            timers.insert(std::make_pair(Clock::now() + delay, timer));
+        }
+        cv.notify_one();
+
+        return id;
+    }
+
+    // Stops a timer, it won't fire again once this returns (a run already in progress still finishes)
+    void cancel(unsigned long long id) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (std::multimap<Clock::time_point, Timer>::iterator it = timers.begin(); it != timers.end(); ++it) {
+            if (it->second.id == id) {
+                timers.erase(it);
+                return;
+            }
+        }
+    }
+
+    // Waits until everything posted before this call has run. Used before deleting
+    // something that posted tasks are still pointing to.
+    void sync() {
+        if (std::this_thread::get_id() == worker.get_id()) return;
+
+        std::mutex done_mtx;
+        std::condition_variable done_cv;
+        bool done = false;
+
+        post([&]() {
+            std::lock_guard<std::mutex> lock(done_mtx);
+            done = true;
+            done_cv.notify_one();
+        });
+
+        std::unique_lock<std::mutex> lock(done_mtx);
+        done_cv.wait(lock, [&]() { return done; });
+    }
+};
+
+#endif
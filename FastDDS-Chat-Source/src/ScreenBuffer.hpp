@@ -0,0 +1,165 @@
+/**
+ * @file ScreenBuffer.hpp
+ */
+
+#ifndef SCREENBUFFER_H
+#define SCREENBUFFER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum CellStyle {
+    STYLE_NORMAL,
+    STYLE_REVERSE,      // Title bars
+    STYLE_BOLD,
+    STYLE_DIM,
+};
+
+// Two copies of the screen, one cell per column: back is drawn into every frame, front is what
+// the terminal shows. flush() only writes the cells that differ, so the cost of a frame depends
+// on how much changed, not on how many messages arrived since the last one.
+// Every character counts as one column (wide CJK/emoji characters will be misaligned).
+class ScreenBuffer {
+private:
+    struct Cell {
+        std::string glyph;      // One UTF-8 character, empty in front means "unknown, redraw"
+        uint8_t style;
+
+        Cell() : glyph(" "), style(STYLE_NORMAL) {}
+
+        bool operator==(const Cell& other) const {
+            return style == other.style && glyph == other.glyph;
+        }
+    };
+
+    int rows;
+    int cols;
+    std::vector<Cell> back;
+    std::vector<Cell> front;
+    bool clear_first;
+    int cursor_row;
+    int cursor_col;
+
+    static const char* styleCode(uint8_t style) {
+        switch (style) {
+        case STYLE_REVERSE: return "\033[0;7m";
+        case STYLE_BOLD: return "\033[0;1m";
+        case STYLE_DIM: return "\033[0;2m";
+        default: return "\033[0m";
+        }
+    }
+
+public:
+    ScreenBuffer() : rows(0), cols(0), clear_first(true), cursor_row(-1), cursor_col(-1) {}
+
+    int getRows() const {
+        return rows;
+    }
+
+    int getCols() const {
+        return cols;
+    }
+
+    // Also forgets what the terminal shows, so the next flush() draws everything
+    void resize(int rows, int cols) {
+        this->rows = rows;
+        this->cols = cols;
+        back.assign(static_cast<size_t>(rows) * cols, Cell());
+        front.assign(back.size(), Cell());
+
+        for (Cell& cell : front) {
+            cell.glyph.clear();
+        }
+
+        clear_first = true;
+    }
+
+    void clear() {
+        for (Cell& cell : back) {
+            cell.glyph = " ";
+            cell.style = STYLE_NORMAL;
+        }
+    }
+
+    // Writes text from (row, col) using at most max_cols columns, returns how many were used.
+    // Control characters show as '?'.
+    int put(int row, int col, const std::string& text, uint8_t style, int max_cols = -1) {
+        if (row < 0 || row >= rows || col < 0) return 0;
+
+        int limit = cols - col;
+        if (max_cols >= 0 && max_cols < limit) limit = max_cols;
+
+        int used = 0;
+        size_t i = 0;
+
+        while (i < text.size() && used < limit) {
+            unsigned char lead = static_cast<unsigned char>(text[i]);
+            size_t length = lead >= 0xf0 ? 4 : (lead >= 0xe0 ? 3 : (lead >= 0xc0 ? 2 : 1));
+            if (i + length > text.size()) length = text.size() - i;
+
+            Cell& cell = back[static_cast<size_t>(row) * cols + col + used];
+            cell.glyph = lead < 32 || lead == 127 ? std::string("?") : text.substr(i, length);
+            cell.style = style;
+
+            i += length;
+            used++;
+        }
+
+        return used;
+    }
+
+    void fill(int row, int col, int count, const std::string& glyph, uint8_t style) {
+        for (int i = 0; i < count && col + i < cols; i++) {
+            put(row, col + i, glyph, style, 1);
+        }
+    }
+
+    // Terminal output that brings the screen up to date and leaves the cursor at (cursor_row, cursor_col).
+    // Empty if nothing changed.
+    std::string flush(int cursor_row, int cursor_col) {
+        std::string out = "\033[?25l";
+        int at_row = -1, at_col = -1;
+        uint8_t at_style = 255;
+        bool changed = clear_first || cursor_row != this->cursor_row || cursor_col != this->cursor_col;
+
+        if (clear_first) {
+            out += "\033[0m\033[2J";
+            clear_first = false;
+        }
+
+        for (int row = 0; row < rows; row++) {
+            for (int col = 0; col < cols; col++) {
+                // Writing the bottom right cell scrolls some terminals
+                if (row == rows - 1 && col == cols - 1) continue;
+
+                size_t i = static_cast<size_t>(row) * cols + col;
+                if (back[i] == front[i]) continue;
+
+                if (row != at_row || col != at_col) {
+                    out += "\033[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H";
+                }
+                if (back[i].style != at_style) {
+                    out += styleCode(back[i].style);
+                    at_style = back[i].style;
+                }
+
+                out += back[i].glyph;
+                front[i] = back[i];
+                changed = true;
+                at_row = row;
+                at_col = col + 1;
+            }
+        }
+
+        if (!changed) return "";
+
+        this->cursor_row = cursor_row;
+        this->cursor_col = cursor_col;
+
+        out += "\033[0m\033[" + std::to_string(cursor_row + 1) + ";" + std::to_string(cursor_col + 1) + "H\033[?25h";
+        return out;
+    }
+};
+
+#endif
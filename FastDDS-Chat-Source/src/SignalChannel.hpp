@@ -0,0 +1,293 @@
+/**
+ * @file SignalChannel.hpp
+ */
+
+#ifndef SIGNALCHANNEL_H
+#define SIGNALCHANNEL_H
+
+#include "UserChatPubSubTypes.hpp"
+#include "ChatParticipant.hpp"
+#include "ConsoleWriter.hpp"
+#include "Globals.hpp"
+#include "QosProfiles.hpp"
+#include "Reactor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fastdds/dds/domain/DomainParticipant.hpp>
+#include <fastdds/dds/publisher/DataWriter.hpp>
+#include <fastdds/dds/publisher/Publisher.hpp>
+#include <fastdds/dds/publisher/qos/DataWriterQos.hpp>
+#include <fastdds/dds/subscriber/DataReader.hpp>
+#include <fastdds/dds/subscriber/DataReaderListener.hpp>
+#include <fastdds/dds/subscriber/qos/DataReaderQos.hpp>
+#include <fastdds/dds/subscriber/SampleInfo.hpp>
+#include <fastdds/dds/subscriber/Subscriber.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Kinds of signal, sent in the message field. The index field carries a value for kinds that need one.
+const std::string SIGNAL_TYPING = "typing";
+const std::string SIGNAL_IDLE = "idle";
+
+// A kind of signal is sent to a peer at most this often, the latest one is sent when the time is up
+const unsigned int SIGNAL_MIN_INTERVAL_MS = 1000;
+
+// How long "typing" lasts without being repeated
+const unsigned int TYPING_TIMEOUT_MS = 3000;
+
+// Throwaway signals (typing, ...) between this user and one contact. They go on their own
+// best-effort, keep-last-1 topics (<pair>_signal) so they never hold up chat text in the
+// reliable protocol, and a lost signal is simply replaced by the next one.
+class SignalChannel {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    DomainParticipant* participant_;
+    Publisher* publisher_;
+    Subscriber* subscriber_;
+    Topic* out_topic_;
+    Topic* in_topic_;
+    DataWriter* writer_;
+    DataReader* reader_;
+
+    std::string own_name;
+    std::string peer_name;
+    std::string chat_tab;               // Value of curr_tab[1] while this chat is open
+    std::vector<std::string>* curr_tab;
+
+    std::mutex mtx;
+    std::unordered_map<std::string, Clock::time_point> last_sent;   // Kind -> when it was last written
+    std::unordered_map<std::string, uint32_t> pending;              // Kind -> value waiting for the interval to end
+    std::unordered_map<std::string, unsigned long long> timers;     // Kind -> reactor timer that sends it
+
+    std::atomic<long long> typing_until;    // Steady clock ms, 0 if the peer isn't typing
+
+    class SignalListener : public DataReaderListener
+    {
+    private:
+        SignalChannel* channel_;
+        UserChat signal_;
+    public:
+        SignalListener(SignalChannel* channel) : channel_(channel) {}
+        ~SignalListener() override {}
+
+        void on_data_available(DataReader* reader) override
+        {
+            SampleInfo info;
+
+            while (reader->take_next_sample(&signal_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+                if (info.valid_data) {
+                    channel_->received(signal_.message(), signal_.index());
+                }
+            }
+        }
+    } listener_;
+
+    static long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void received(const std::string& kind, uint32_t) {
+        if (kind == SIGNAL_TYPING) {
+            bool was_typing = isPeerTyping();
+            typing_until = nowMs() + TYPING_TIMEOUT_MS;
+
+            if (!was_typing && isChatOpen(curr_tab, chat_tab)) {
+                ConsoleWriter::get().writeLine("(" + peer_name + " is typing...)");
+            }
+        }
+        else if (kind == SIGNAL_IDLE) {
+            typing_until = 0;
+        }
+    }
+
+    void write(const std::string& kind, uint32_t value) {
+        UserChat signal;
+        signal.index(value);
+        signal.username(own_name);
+        signal.message(kind);
+
+        writer_->write(&signal);
+    }
+
+    // Sends whatever is pending for kind, runs on the reactor thread
+    void flushPending(const std::string& kind) {
+        std::lock_guard<std::mutex> lock(mtx);
+        timers.erase(kind);
+
+        std::unordered_map<std::string, uint32_t>::iterator it = pending.find(kind);
+        if (it == pending.end()) return;
+
+        write(kind, it->second);
+        last_sent[kind] = Clock::now();
+        pending.erase(it);
+    }
+
+public:
+    SignalChannel(const std::string& own_name, const std::string& peer_name, std::vector<std::string>* tab)
+        : participant_(nullptr)
+        , publisher_(nullptr)
+        , subscriber_(nullptr)
+        , out_topic_(nullptr)
+        , in_topic_(nullptr)
+        , writer_(nullptr)
+        , reader_(nullptr)
+        , own_name(own_name)
+        , peer_name(peer_name)
+        , chat_tab(peer_name + "_" + own_name)
+        , curr_tab(tab)
+        , typing_until(0)
+        , listener_(this)
+    {}
+
+    SignalChannel(const SignalChannel&) = delete;
+    SignalChannel& operator=(const SignalChannel&) = delete;
+
+    ~SignalChannel() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (std::unordered_map<std::string, unsigned long long>::iterator it = timers.begin(); it != timers.end(); ++it) {
+                Reactor::get().cancel(it->second);
+            }
+
+            timers.clear();
+        }
+
+        // A timer that already started still points here
+        Reactor::get().sync();
+
+        if (participant_ == nullptr) return;
+
+        if (writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(writer_);
+        }
+        if (publisher_ != nullptr)
+        {
+            participant_->delete_publisher(publisher_);
+        }
+        if (reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(reader_);
+        }
+        if (subscriber_ != nullptr)
+        {
+            participant_->delete_subscriber(subscriber_);
+        }
+        if (out_topic_ != nullptr)
+        {
+            participant_->delete_topic(out_topic_);
+        }
+        if (in_topic_ != nullptr)
+        {
+            participant_->delete_topic(in_topic_);
+        }
+
+        ChatParticipant::release();
+    }
+
+    bool init()
+    {
+        participant_ = ChatParticipant::acquire();
+
+        if (participant_ == nullptr)
+        {
+            return false;
+        }
+
+        out_topic_ = participant_->create_topic(own_name + "_" + peer_name + "_signal", "UserChat", TOPIC_QOS_DEFAULT);
+        in_topic_ = participant_->create_topic(peer_name + "_" + own_name + "_signal", "UserChat", TOPIC_QOS_DEFAULT);
+
+        if (out_topic_ == nullptr || in_topic_ == nullptr)
+        {
+            return false;
+        }
+
+        // Only the newest signal matters, nothing is resent or kept for late joiners
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        writerQos.reliability().kind = BEST_EFFORT_RELIABILITY_QOS;
+        writerQos.durability().kind = VOLATILE_DURABILITY_QOS;
+        writerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        writerQos.history().depth = 1;
+
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        readerQos.reliability().kind = BEST_EFFORT_RELIABILITY_QOS;
+        readerQos.durability().kind = VOLATILE_DURABILITY_QOS;
+        readerQos.history().kind = KEEP_LAST_HISTORY_QOS;
+        readerQos.history().depth = 1;
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
+
+        if (publisher_ == nullptr)
+        {
+            return false;
+        }
+
+        writer_ = publisher_->create_datawriter(out_topic_, writerQos, nullptr);
+
+        if (writer_ == nullptr)
+        {
+            return false;
+        }
+
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
+
+        if (subscriber_ == nullptr)
+        {
+            return false;
+        }
+
+        reader_ = subscriber_->create_datareader(in_topic_, readerQos, &listener_);
+
+        if (reader_ == nullptr)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // Sends a signal now, or when SIGNAL_MIN_INTERVAL_MS has passed since the last one of the same kind.
+    // Signals sent in between replace each other, only the latest is sent.
+    void signal(const std::string& kind, uint32_t value = 0) {
+        if (writer_ == nullptr) return;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        Clock::time_point now = Clock::now();
+
+        // A late "typing" would undo this
+        if (kind == SIGNAL_IDLE) pending.erase(SIGNAL_TYPING);
+
+        std::chrono::milliseconds interval(SIGNAL_MIN_INTERVAL_MS);
+
+        std::unordered_map<std::string, Clock::time_point>::iterator sent = last_sent.find(kind);
+
+        if (sent == last_sent.end() || now - sent->second >= interval) {
+            pending.erase(kind);
+            write(kind, value);
+            last_sent[kind] = now;
+            return;
+        }
+
+        pending[kind] = value;
+
+        if (timers.count(kind) == 0) {
+            std::chrono::milliseconds wait = std::chrono::duration_cast<std::chrono::milliseconds>(sent->second + interval - now);
+            timers[kind] = Reactor::get().schedule(wait, [this, kind]() { flushPending(kind); });
+        }
+    }
+
+    bool isPeerTyping() const {
+        long long until = typing_until.load();
+        return until != 0 && nowMs() < until;
+    }
+};
+
+#endif
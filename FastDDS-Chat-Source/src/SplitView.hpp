@@ -0,0 +1,423 @@
+/**
+ * @file SplitView.hpp
+ */
+
+#ifndef SPLITVIEW_H
+#define SPLITVIEW_H
+
+#include "ChatConfig.hpp"
+#include "ConsoleWriter.hpp"
+#include "ContactRegistry.hpp"
+#include "LineEditor.hpp"
+#include "PresenceRoster.hpp"
+#include "ScreenBuffer.hpp"
+#include "TerminalInput.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// At most this many frames a second, however fast messages come in
+const int SPLIT_FRAME_MS = 33;
+
+const int ROSTER_WIDTH = 24;
+
+// Several chats on one screen: a roster with online state and unread counts on the left, one
+// pane per open chat on the right and a shared input line at the bottom. Everything is drawn
+// into a ScreenBuffer and only the changed cells go to the terminal, at most once per frame.
+// Keys: Tab moves between panes, PgUp/PgDn scroll, Ctrl-D leaves.
+// Commands: /open <user>, /close, /urgent <text>, /exit. Anything else is sent to the chat with focus.
+class SplitView {
+private:
+    struct Pane {
+        std::string user;
+        size_t scroll;                  // Messages back from the newest
+        std::vector<std::string> lines; // What's shown, fetched again when one of these changes:
+        size_t fetched_size;
+        size_t fetched_scroll;
+        int fetched_rows;
+
+        Pane(const std::string& user) : user(user), scroll(0), fetched_size(0), fetched_scroll(0), fetched_rows(-1) {}
+    };
+
+    ContactRegistry& contacts;
+
+    std::vector<Pane> panes;
+    size_t focus;
+    InputLine input;
+    std::unordered_map<std::string, size_t> seen;   // History size the user has seen, per contact
+
+    std::mutex status_mtx;
+    std::string status;                 // Last thing printed through ConsoleWriter
+
+    ScreenBuffer screen;
+    bool done;
+
+    Contact* focused() {
+        return panes.empty() ? nullptr : contacts.find(panes[focus].user);
+    }
+
+    void setStatus(const std::string& text) {
+        std::lock_guard<std::mutex> lock(status_mtx);
+        status = text;
+    }
+
+    // Whatever ConsoleWriter would have printed, only the last line is kept (without colour codes)
+    void captured(const std::string& text) {
+        std::string line;
+
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\033') {
+                while (i < text.size() && !isalpha(static_cast<unsigned char>(text[i]))) i++;
+            }
+            else if (text[i] == '\n') {
+                if (!line.empty()) setStatus(line);
+                line.clear();
+            }
+            else if (text[i] != '\r') {
+                line += text[i];
+            }
+        }
+
+        if (!line.empty()) setStatus(line);
+    }
+
+    void open(const std::string& user) {
+        Contact* contact = contacts.find(user);
+
+        if (contact == nullptr) {
+            setStatus("You haven't added " + user + ".");
+            return;
+        }
+
+        for (size_t i = 0; i < panes.size(); i++) {
+            if (panes[i].user == user) {
+                focus = i;
+                return;
+            }
+        }
+
+        contact->startAsync();
+
+        // Takes the place of the chat with focus once every pane is in use
+        if (static_cast<int>(panes.size()) < chatConfig().split_panes) {
+            panes.push_back(Pane(user));
+            focus = panes.size() - 1;
+        }
+        else {
+            panes[focus] = Pane(user);
+        }
+    }
+
+    void close() {
+        if (panes.empty()) return;
+
+        panes.erase(panes.begin() + focus);
+        if (focus >= panes.size()) focus = panes.empty() ? 0 : panes.size() - 1;
+    }
+
+    void submit(const std::string& line) {
+        if (line == "/exit") {
+            done = true;
+        }
+        else if (line.compare(0, 6, "/open ") == 0) {
+            open(line.substr(6));
+        }
+        else if (line == "/close") {
+            close();
+        }
+        else if (!line.empty()) {
+            Contact* contact = focused();
+
+            if (contact == nullptr) {
+                setStatus("Open a chat first with /open <user>.");
+            }
+            else if (contact->isFailed()) {
+                setStatus("Couldn't connect to " + contact->getUsername() + ".");
+            }
+            else if (!contact->isStarted()) {
+                setStatus("Still connecting to " + contact->getUsername() + ".");
+            }
+            else if (!PresenceRoster::get().isOnline(contact->getUsername())) {
+                setStatus(contact->getUsername() + " is offline.");
+            }
+            else if (!contact->getPub()->getStatus()) {
+                setStatus(contact->getUsername() + " is online but the chat isn't connected yet. Message discarded.");
+            }
+            else if (line.compare(0, 8, "/urgent ") == 0) {
+                if (contact->getPub()->sendUrgent(line.substr(8)) != PUBLISH_OK) {
+                    setStatus("Urgent message to " + contact->getUsername() + " discarded.");
+                }
+            }
+            else if (!contact->getPub()->send(line)) {
+                setStatus(contact->getUsername() + " isn't keeping up. Message discarded.");
+            }
+        }
+    }
+
+    void handleKey(TerminalKey key, const std::string& chars) {
+        size_t page = 10;
+
+        switch (key) {
+        case KEY_EOF:
+            done = true;
+            return;
+        case KEY_TAB:
+            if (!panes.empty()) focus = (focus + 1) % panes.size();
+            return;
+        case KEY_PAGE_UP:
+            if (!panes.empty()) panes[focus].scroll += page;
+            return;
+        case KEY_PAGE_DOWN:
+            if (!panes.empty()) panes[focus].scroll = panes[focus].scroll > page ? panes[focus].scroll - page : 0;
+            return;
+        default:
+            break;
+        }
+
+        std::string ignored;
+
+        if (LineEditor::applyKey(key, chars, input, ignored)) {
+            std::string line = input.text;
+            input.text.clear();
+            input.cursor = 0;
+            submit(line);
+            return;
+        }
+
+        Contact* contact = focused();
+
+        if (contact != nullptr && contact->isStarted() && (key == KEY_CHAR || key == KEY_BACKSPACE || key == KEY_DELETE)) {
+            contact->getSignals()->signal(SIGNAL_TYPING);
+        }
+    }
+
+    void drawRoster(int rows) {
+        std::vector<std::string> names;
+
+        for (ContactRegistry::iterator it = contacts.begin(); it != contacts.end(); ++it) {
+            names.push_back(it->first);
+        }
+
+        std::sort(names.begin(), names.end());
+
+        screen.fill(0, 0, ROSTER_WIDTH, " ", STYLE_REVERSE);
+        screen.put(0, 1, "Contacts (" + std::to_string(names.size()) + ")", STYLE_REVERSE, ROSTER_WIDTH - 1);
+
+        for (size_t i = 0; i < names.size(); i++) {
+            int row = static_cast<int>(i) + 1;
+
+            if (row >= rows - 1 && i + 1 < names.size()) {
+                screen.put(row, 1, "+" + std::to_string(names.size() - i) + " more", STYLE_DIM, ROSTER_WIDTH - 1);
+                break;
+            }
+
+            Contact* contact = contacts.find(names[i]);
+            size_t size = contact->getHistory()->size();
+            size_t unread = size - std::min(size, seen[names[i]]);
+            bool online = PresenceRoster::get().isOnline(names[i]);
+
+            std::string entry = std::string(online ? "* " : "  ") + names[i];
+            if (unread > 0) entry += " (" + std::to_string(unread) + ")";
+
+            screen.put(row, 1, entry, unread > 0 ? STYLE_BOLD : (online ? STYLE_NORMAL : STYLE_DIM), ROSTER_WIDTH - 2);
+        }
+
+        for (int row = 0; row < rows; row++) {
+            screen.put(row, ROSTER_WIDTH, "\xe2\x94\x82", STYLE_DIM, 1);
+        }
+    }
+
+    void drawPane(Pane& pane, bool has_focus, int top, int height, int left, int width) {
+        Contact* contact = contacts.find(pane.user);
+        if (contact == nullptr || height < 2) return;
+
+        ChatHistory* history = contact->getHistory();
+        size_t size = history->size();
+        int rows = height - 1;
+
+        if (pane.scroll > size) pane.scroll = size;
+
+        // Only asks the history again when something it would return changed
+        if (size != pane.fetched_size || pane.scroll != pane.fetched_scroll || rows != pane.fetched_rows) {
+            history->page(size - pane.scroll, static_cast<size_t>(rows), pane.lines);
+            pane.fetched_size = size;
+            pane.fetched_scroll = pane.scroll;
+            pane.fetched_rows = rows;
+        }
+
+        // Showing the newest messages counts as reading them
+        if (pane.scroll == 0 && seen[pane.user] != size) {
+            seen[pane.user] = size;
+            if (contact->isStarted()) contact->getSub()->markRead();
+        }
+
+        std::string title = " " + pane.user;
+
+        if (contact->isFailed()) title += " (not connected)";
+        else if (!contact->isStarted()) title += " (connecting)";
+        else if (!PresenceRoster::get().isOnline(pane.user)) title += " (offline)";
+        else if (contact->getSignals()->isPeerTyping()) title += " (typing...)";
+
+        if (pane.scroll > 0) title += " [" + std::to_string(pane.scroll) + " back]";
+
+        screen.fill(top, left, width, has_focus ? "\xe2\x94\x81" : "\xe2\x94\x80", has_focus ? STYLE_BOLD : STYLE_DIM);
+        screen.put(top, left + 1, title + " ", has_focus ? STYLE_REVERSE : STYLE_NORMAL, width - 2);
+
+        // Newest at the bottom
+        int first_row = top + 1 + rows - static_cast<int>(pane.lines.size());
+
+        for (size_t i = 0; i < pane.lines.size(); i++) {
+            screen.put(first_row + static_cast<int>(i), left, pane.lines[i], STYLE_NORMAL, width);
+        }
+    }
+
+    // Builds the frame and writes what changed
+    void render() {
+        int rows = 0, cols = 0;
+
+        if (!TerminalInput::size(rows, cols)) {
+            rows = 24;
+            cols = 80;
+        }
+
+        if (rows != screen.getRows() || cols != screen.getCols()) {
+            screen.resize(rows, cols);
+        }
+
+        screen.clear();
+
+        int left = ROSTER_WIDTH + 1;
+        int width = cols - left;
+        int body = rows - 2;
+
+        if (width < 10 || body < 4) {
+            screen.put(0, 0, "Terminal too small", STYLE_NORMAL);
+        }
+        else {
+            drawRoster(body);
+
+            int count = static_cast<int>(panes.size());
+
+            if (count == 0) {
+                screen.put(body / 2, left + 2, "/open <user> to start a chat, Tab to switch, Ctrl-D to leave.", STYLE_DIM, width - 2);
+            }
+
+            for (int i = 0; i < count; i++) {
+                int top = body * i / count;
+                int bottom = body * (i + 1) / count;
+                drawPane(panes[i], static_cast<size_t>(i) == focus, top, bottom - top, left, width);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(status_mtx);
+            screen.put(rows - 2, 0, status, STYLE_DIM);
+        }
+
+        // The input line scrolls sideways so the cursor stays in view
+        std::string prompt = (panes.empty() ? std::string("") : "[" + panes[focus].user + "] ") + "> ";
+        int prompt_cols = screen.put(rows - 1, 0, prompt, STYLE_BOLD);
+        int room = std::max(1, cols - prompt_cols - 1);
+
+        std::vector<size_t> starts;     // Byte offset of every character
+        size_t cursor_char = 0;
+
+        for (size_t i = 0; i < input.text.size(); i++) {
+            if ((static_cast<unsigned char>(input.text[i]) & 0xc0) != 0x80) {
+                if (i < input.cursor) cursor_char++;
+                starts.push_back(i);
+            }
+        }
+
+        size_t first = cursor_char > static_cast<size_t>(room) ? cursor_char - room : 0;
+        size_t from = first < starts.size() ? starts[first] : input.text.size();
+
+        screen.put(rows - 1, prompt_cols, input.text.substr(from), STYLE_NORMAL, room);
+
+        std::string out = screen.flush(rows - 1, prompt_cols + static_cast<int>(cursor_char - first));
+
+        if (!out.empty()) {
+            std::cout.write(out.data(), out.size());
+            std::cout.flush();
+        }
+    }
+
+public:
+    SplitView(ContactRegistry& contacts, const std::string& username)
+        : contacts(contacts)
+        , focus(0)
+        , status("Signed in as " + username + ".")
+        , done(false)
+    {}
+
+    SplitView(const SplitView&) = delete;
+    SplitView& operator=(const SplitView&) = delete;
+
+    // Runs until /exit or Ctrl-D. Returns false straight away if stdin isn't a terminal.
+    bool run() {
+        TerminalInput terminal;
+
+        if (!terminal.isRaw()) return false;
+
+        // Everything counts as seen when the view opens, unread counts start from here
+        std::vector<std::string> names;
+
+        for (ContactRegistry::iterator it = contacts.begin(); it != contacts.end(); ++it) {
+            seen[it->first] = it->second->getHistory()->size();
+            names.push_back(it->first);
+        }
+
+        // Starts with the first contacts alphabetically, /open swaps them
+        std::sort(names.begin(), names.end());
+
+        for (size_t i = 0; i < names.size() && static_cast<int>(i) < chatConfig().split_panes; i++) {
+            open(names[i]);
+        }
+
+        focus = 0;
+
+        ConsoleWriter::get().flush();
+        ConsoleWriter::get().setSink([this](const std::string& text) { captured(text); });
+
+        // Alternate screen, the menu comes back as it was afterwards
+        std::cout << "\033[?1049h" << std::flush;
+        terminal.setSignalText("\033[0m\033[?25h\033[?1049l");
+
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point next_frame = Clock::now();
+
+        while (!done) {
+            int wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next_frame - Clock::now()).count());
+
+            std::string chars;
+            TerminalKey key = terminal.readKey(chars, std::max(0, wait));
+
+            if (key != KEY_NONE) {
+                handleKey(key, chars);
+
+                // Keys are drawn straight away so typing never waits for a frame
+                render();
+                continue;
+            }
+
+            if (Clock::now() >= next_frame) {
+                render();
+                next_frame = Clock::now() + std::chrono::milliseconds(SPLIT_FRAME_MS);
+            }
+        }
+
+        terminal.setSignalText(nullptr);
+        std::cout << "\033[0m\033[?1049l" << std::flush;
+        ConsoleWriter::get().setSink(std::function<void(const std::string&)>());
+
+        return true;
+    }
+};
+
+#endif
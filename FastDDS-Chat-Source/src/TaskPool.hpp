@@ -0,0 +1,290 @@
+/**
+ * @file TaskPool.hpp
+ */
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Trace.hpp"
+
+// Work-stealing pool for the processing done after a message is received.
+// Every worker has its own deque, idle workers steal from the back of the others.
+class TaskPool {
+private:
+    struct Worker {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mtx;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    std::atomic<size_t> next_worker;   // Round robin for tasks submitted from outside the pool
+    std::atomic<int> queued;
+
+    std::mutex sleep_mtx;
+    std::condition_variable sleep_cv;
+
+    // Index of the worker running on this thread, -1 outside the pool
+    static int& currentWorker() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    TaskPool() : running(true), next_worker(0), queued(0) {
+        unsigned int count = std::thread::hardware_concurrency();
+        if (count < 2) count = 2;
+
+        for (unsigned int i = 0; i < count; i++) {
+            workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        }
+
+        for (unsigned int i = 0; i < count; i++) {
+            threads.push_back(std::thread(&TaskPool::run, this, static_cast<int>(i)));
+        }
+    }
+
+    bool popLocal(int index, std::function<void()>& task) {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mtx);
+
+        if (worker.tasks.empty()) return false;
+
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int index, std::function<void()>& task) {
+        size_t count = workers.size();
+
+        for (size_t i = 1; i < count; i++) {
+            Worker& victim = *workers[(index + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void run(int index) {
+        CHAT_TRACE_THREAD("task pool");
+        currentWorker() = index;
+        std::function<void()> task;
+
+        while (true) {
+            if (popLocal(index, task) || steal(index, task)) {
+                queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mtx);
+
+            if (!running.load() && queued.load() == 0) break;
+
+            if (queued.load() == 0) {
+                sleep_cv.wait_for(lock, std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+    void enqueue(std::function<void()> task, bool front) {
+        int index = currentWorker();
+        bool local = index >= 0;
+
+        if (!local) index = static_cast<int>(next_worker.fetch_add(1) % workers.size());
+
+        {
+            Worker& worker = *workers[index];
+            std::lock_guard<std::mutex> lock(worker.mtx);
+
+            if (local && front) worker.tasks.push_front(std::move(task));
+            else worker.tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleep_mtx);
+            queued.fetch_add(1);
+        }
+        sleep_cv.notify_one();
+    }
+
+public:
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mtx);
+            running.store(false);
+        }
+        sleep_cv.notify_all();
+
+        for (std::thread& thread : threads) {
+            if (thread.joinable()) thread.join();
+        }
+    }
+
+    static TaskPool& get() {
+        static TaskPool instance;
+        return instance;
+    }
+
+    // Tasks submitted from a worker stay on that worker (front of its deque), others are spread round robin
+    void submit(std::function<void()> task) {
+        enqueue(std::move(task), true);
+    }
+
+    // Like submit(), but a worker queues it behind everything it already has, for a task that gives others a turn
+    void yield(std::function<void()> task) {
+        enqueue(std::move(task), false);
+    }
+};
+
+// Threads for tasks that block for a long time, like creating a contact's DDS endpoints,
+// so they never hold up the pool's workers and the strands waiting on them.
+// Tasks run in the order they were submitted, BLOCKING_TASK_THREADS at a time.
+class BlockingTasks {
+private:
+    static const int BLOCKING_TASK_THREADS = 2;
+
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::thread> threads;
+    bool running;
+
+    BlockingTasks() : running(true) {
+        for (int i = 0; i < BLOCKING_TASK_THREADS; i++) {
+            threads.push_back(std::thread(&BlockingTasks::run, this));
+        }
+    }
+
+    void run() {
+        CHAT_TRACE_THREAD("blocking tasks");
+
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return !tasks.empty() || !running; });
+
+                // Whatever is queued still runs, someone may be waiting for it
+                if (tasks.empty()) return;
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+public:
+    BlockingTasks(const BlockingTasks&) = delete;
+    BlockingTasks& operator=(const BlockingTasks&) = delete;
+
+    ~BlockingTasks() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running = false;
+        }
+        cv.notify_all();
+
+        for (std::thread& thread : threads) {
+            if (thread.joinable()) thread.join();
+        }
+    }
+
+    static BlockingTasks& get() {
+        static BlockingTasks instance;
+        return instance;
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+};
+
+// Runs tasks for one conversation on the pool one at a time and in order,
+// different conversations still run in parallel.
+class Strand {
+private:
+    static const int MAX_TASKS_PER_RUN = 64;   // Gives other conversations a turn on busy chats
+
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable idle_cv;
+    bool scheduled;
+
+    void drain() {
+        for (int i = 0; i < MAX_TASKS_PER_RUN; i++) {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                if (tasks.empty()) {
+                    scheduled = false;
+                    idle_cv.notify_all();
+                    return;
+                }
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+
+        TaskPool::get().yield([this]() { drain(); });
+    }
+
+public:
+    Strand() : scheduled(false) {}
+
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    ~Strand() {
+        waitIdle();
+    }
+
+    void post(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.push_back(std::move(task));
+
+        if (!scheduled) {
+            scheduled = true;
+            TaskPool::get().submit([this]() { drain(); });
+        }
+    }
+
+    // Waits until every posted task has run
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(mtx);
+        idle_cv.wait(lock, [this]() { return !scheduled; });
+    }
+};
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file TerminalInput.hpp
+ */
+
+#ifndef TERMINALINPUT_H
+#define TERMINALINPUT_H
+
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#undef max
+#undef min
+
+// Key presses as read by TerminalInput
+enum TerminalKey {
+    KEY_NONE,
+    KEY_CHAR,
+    KEY_ENTER,
+    KEY_TAB,
+    KEY_BACKSPACE,
+    KEY_DELETE,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_KILL_LINE,
+    KEY_EOF,
+};
+
+// Puts the terminal in raw mode (no line buffering or echo, Ctrl-C still works) for as long as
+// it exists, and reads one key at a time. Does nothing when stdin isn't a terminal.
+// Ctrl-C and the like still end the program, but the terminal is put back first.
+class TerminalInput {
+private:
+    bool raw;
+
+#ifdef _WIN32
+    HANDLE in_handle;
+    HANDLE out_handle;
+    DWORD old_in_mode;
+    DWORD old_out_mode;
+#else
+    termios old_mode;
+    struct sigaction old_actions[3];
+#endif
+
+    // What the signal handler restores, set before it is installed
+#ifdef _WIN32
+    static HANDLE& signalHandle() {
+        static HANDLE handle = nullptr;
+        return handle;
+    }
+
+    static DWORD& signalMode() {
+        static DWORD mode = 0;
+        return mode;
+    }
+#else
+    static const int* restoredSignals() {
+        static const int signals[3] = { SIGINT, SIGTERM, SIGHUP };
+        return signals;
+    }
+
+    static termios& signalMode() {
+        static termios mode;
+        return mode;
+    }
+#endif
+
+    // Can change while the handler is installed, hence atomic (lock-free, so safe in a handler)
+    static std::atomic<const char*>& signalText() {
+        static std::atomic<const char*> text(nullptr);
+        return text;
+    }
+
+#ifdef _WIN32
+    static BOOL WINAPI restoreOnSignal(DWORD) {
+        const char* text = signalText();
+        DWORD written;
+
+        if (text != nullptr) WriteFile(signalHandle(), text, static_cast<DWORD>(std::strlen(text)), &written, nullptr);
+        SetConsoleMode(signalHandle(), signalMode());
+
+        // The default handler ends the program
+        return FALSE;
+    }
+#else
+    // Only async-signal-safe calls, then the signal is raised again to end the program as usual
+    static void restoreOnSignal(int signal_number) {
+        const char* text = signalText();
+
+        if (text != nullptr) {
+            ssize_t ignored = ::write(STDOUT_FILENO, text, std::strlen(text));
+            (void)ignored;
+        }
+
+        tcsetattr(STDIN_FILENO, TCSANOW, &signalMode());
+
+        ::signal(signal_number, SIG_DFL);
+        ::raise(signal_number);
+    }
+#endif
+
+    // Waits up to timeout_ms for one byte, returns false if none came
+    bool readByte(unsigned char& byte, int timeout_ms) {
+#ifdef _WIN32
+        for (int waited = 0; !_kbhit(); waited += 10) {
+            if (waited >= timeout_ms) return false;
+            Sleep(10);
+        }
+
+        byte = static_cast<unsigned char>(_getch());
+        return true;
+#else
+        pollfd fd;
+        fd.fd = STDIN_FILENO;
+        fd.events = POLLIN;
+        fd.revents = 0;
+
+        if (poll(&fd, 1, timeout_ms) <= 0) return false;
+
+        ssize_t got = ::read(STDIN_FILENO, &byte, 1);
+
+        // EOF reads as Ctrl-D
+        if (got == 0) byte = 4;
+        return got >= 0;
+#endif
+    }
+
+public:
+    TerminalInput() : raw(false) {
+#ifdef _WIN32
+        in_handle = GetStdHandle(STD_INPUT_HANDLE);
+        out_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+        if (_isatty(_fileno(stdin)) && GetConsoleMode(in_handle, &old_in_mode) && GetConsoleMode(out_handle, &old_out_mode)) {
+            // _getch() already reads unbuffered, the output side has to understand the escape codes
+            SetConsoleMode(out_handle, old_out_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+            raw = true;
+
+            signalHandle() = out_handle;
+            signalMode() = old_out_mode;
+            SetConsoleCtrlHandler(restoreOnSignal, TRUE);
+        }
+#else
+        if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &old_mode) == 0) {
+            termios mode = old_mode;
+
+            mode.c_lflag &= ~(ICANON | ECHO);
+            mode.c_cc[VMIN] = 1;
+            mode.c_cc[VTIME] = 0;
+
+            raw = tcsetattr(STDIN_FILENO, TCSANOW, &mode) == 0;
+        }
+
+        if (raw) {
+            signalMode() = old_mode;
+
+            struct sigaction action;
+            std::memset(&action, 0, sizeof(action));
+            action.sa_handler = restoreOnSignal;
+            sigemptyset(&action.sa_mask);
+
+            for (int i = 0; i < 3; i++) {
+                sigaction(restoredSignals()[i], &action, &old_actions[i]);
+            }
+        }
+#endif
+    }
+
+    TerminalInput(const TerminalInput&) = delete;
+    TerminalInput& operator=(const TerminalInput&) = delete;
+
+    ~TerminalInput() {
+        if (!raw) return;
+
+#ifdef _WIN32
+        SetConsoleCtrlHandler(restoreOnSignal, FALSE);
+        SetConsoleMode(out_handle, old_out_mode);
+#else
+        for (int i = 0; i < 3; i++) {
+            sigaction(restoredSignals()[i], &old_actions[i], nullptr);
+        }
+
+        tcsetattr(STDIN_FILENO, TCSANOW, &old_mode);
+#endif
+        signalText() = nullptr;
+    }
+
+    bool isRaw() const {
+        return raw;
+    }
+
+    // Written to the terminal if a signal ends the program while this is raw, e.g. to leave
+    // the alternate screen. Must be a string literal or otherwise outlive this.
+    void setSignalText(const char* text) {
+        signalText() = text;
+    }
+
+    // Waits up to timeout_ms for a key, chars holds the character (all of its UTF-8 bytes) for KEY_CHAR
+    TerminalKey readKey(std::string& chars, int timeout_ms) {
+        unsigned char ch = 0;
+        if (!readByte(ch, timeout_ms)) return KEY_NONE;
+
+#ifdef _WIN32
+        // Arrows and friends come as 0 or 0xE0 followed by a scan code
+        if (ch == 0 || ch == 0xe0) {
+            unsigned char code = static_cast<unsigned char>(_getch());
+
+            switch (code) {
+            case 75: return KEY_LEFT;
+            case 77: return KEY_RIGHT;
+            case 71: return KEY_HOME;
+            case 79: return KEY_END;
+            case 73: return KEY_PAGE_UP;
+            case 81: return KEY_PAGE_DOWN;
+            case 83: return KEY_DELETE;
+            default: return KEY_NONE;
+            }
+        }
+#else
+        // ESC [ X, ESC O X and ESC [ n ~
+        if (ch == 27) {
+            unsigned char next = 0, code = 0;
+
+            if (!readByte(next, 10) || (next != '[' && next != 'O') || !readByte(code, 10)) return KEY_NONE;
+
+            if (code >= '0' && code <= '9') {
+                unsigned char tilde = 0;
+                if (!readByte(tilde, 10) || tilde != '~') return KEY_NONE;
+
+                switch (code) {
+                case '3': return KEY_DELETE;
+                case '1': case '7': return KEY_HOME;
+                case '4': case '8': return KEY_END;
+                case '5': return KEY_PAGE_UP;
+                case '6': return KEY_PAGE_DOWN;
+                default: return KEY_NONE;
+                }
+            }
+
+            switch (code) {
+            case 'D': return KEY_LEFT;
+            case 'C': return KEY_RIGHT;
+            case 'H': return KEY_HOME;
+            case 'F': return KEY_END;
+            default: return KEY_NONE;
+            }
+        }
+#endif
+
+        if (ch >= 0xc0) {
+            int more = ch >= 0xf0 ? 3 : (ch >= 0xe0 ? 2 : 1);
+            chars.assign(1, static_cast<char>(ch));
+
+            for (int i = 0; i < more; i++) {
+                unsigned char next = 0;
+                if (!readByte(next, 10)) return KEY_NONE;
+                chars.push_back(static_cast<char>(next));
+            }
+
+            return KEY_CHAR;
+        }
+
+        chars.assign(1, static_cast<char>(ch));
+
+        switch (ch) {
+        case '\r':
+        case '\n': return KEY_ENTER;
+        case '\t': return KEY_TAB;
+        case 8:
+        case 127: return KEY_BACKSPACE;
+        case 1: return KEY_HOME;
+        case 5: return KEY_END;
+        case 21: return KEY_KILL_LINE;
+        case 4: return KEY_EOF;
+        default: return ch >= 32 ? KEY_CHAR : KEY_NONE;
+        }
+    }
+
+    // Rows and columns of the terminal, false if it can't tell
+    static bool size(int& rows, int& cols) {
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) return false;
+
+        rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        cols = info.srWindow.Right - info.srWindow.Left + 1;
+        return true;
+#else
+        winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_row == 0 || ws.ws_col == 0) return false;
+
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+        return true;
+#endif
+    }
+};
+
+#endif
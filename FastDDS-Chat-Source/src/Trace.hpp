@@ -0,0 +1,218 @@
+/**
+ * @file Trace.hpp
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+// Timeline spans along a message's path (input, publish, write, serialize, on_data_available,
+// deliver, history, console), written as Chrome trace-event JSON that Perfetto and
+// chrome://tracing open. Only compiled in with FASTDDS_CHAT_TRACE, otherwise the macros are empty.
+//
+// Every thread records into its own fixed-size ring, so a span costs two clock reads and a
+// store, without a lock. A thread's ring is registered (under a lock) the first time it
+// records and is never freed, so it can still be written after the thread has ended.
+// Once a ring is full the newest spans overwrite the oldest, so a trace always has the latest ones.
+
+#ifdef FASTDDS_CHAT_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Spans each thread keeps, about 2.5 MB per thread that records anything
+const size_t TRACE_BUFFER_EVENTS = 1 << 16;
+
+// Names must be string literals, only the pointer is kept
+struct TraceEvent {
+    const char* name;
+    const char* arg_name;       // nullptr for no argument
+    long long arg;
+    long long start_us;
+    long long duration_us;
+};
+
+class Trace {
+private:
+    // Written by its own thread only. count is every span ever recorded, span i is in
+    // events[i % TRACE_BUFFER_EVENTS], so the ring holds [count - TRACE_BUFFER_EVENTS, count).
+    struct Buffer {
+        int tid;
+        std::atomic<const char*> thread_name;
+        std::atomic<size_t> count;
+        std::unique_ptr<TraceEvent[]> events;
+
+        Buffer(int tid) : tid(tid), thread_name(nullptr), count(0), events(new TraceEvent[TRACE_BUFFER_EVENTS]) {}
+    };
+
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    // Wall clock in microseconds at steady clock zero, so spans use the steady clock but traces
+    // from processes on the same machine still line up
+    long long offset_us;
+
+    Trace() {
+        offset_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+            - std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static Buffer* threadBuffer() {
+        static thread_local Buffer* buffer = nullptr;
+
+        if (buffer == nullptr) {
+            Trace& trace = get();
+            std::lock_guard<std::mutex> lock(trace.mtx);
+
+            trace.buffers.push_back(std::unique_ptr<Buffer>(new Buffer(static_cast<int>(trace.buffers.size()) + 1)));
+            buffer = trace.buffers.back().get();
+        }
+
+        return buffer;
+    }
+
+public:
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    static Trace& get() {
+        static Trace trace;
+        return trace;
+    }
+
+    long long nowUs() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + offset_us;
+    }
+
+    void record(const char* name, const char* arg_name, long long arg, long long start_us, long long end_us) {
+        Buffer* buffer = threadBuffer();
+        size_t n = buffer->count.load(std::memory_order_relaxed);
+
+        TraceEvent& event = buffer->events[n % TRACE_BUFFER_EVENTS];
+        event.name = name;
+        event.arg_name = arg_name;
+        event.arg = arg;
+        event.start_us = start_us;
+        event.duration_us = end_us - start_us;
+
+        buffer->count.store(n + 1, std::memory_order_release);
+    }
+
+    // Shown as the calling thread's name in the trace
+    void nameThread(const char* name) {
+        threadBuffer()->thread_name.store(name);
+    }
+
+    // The newest spans of every thread (all but one ring slot), threads can keep recording meanwhile
+    bool write(const std::string& filename) {
+#ifdef _WIN32
+        int pid = _getpid();
+#else
+        int pid = static_cast<int>(getpid());
+#endif
+
+        std::ofstream out(filename);
+        if (!out) return false;
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"FastDDSUser " << pid << "\"}}";
+
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (const std::unique_ptr<Buffer>& buffer : buffers) {
+            size_t count = buffer->count.load(std::memory_order_acquire);
+            // The slot the next span goes into is skipped, the thread may be writing it right now
+            size_t first = count >= TRACE_BUFFER_EVENTS ? count - TRACE_BUFFER_EVENTS + 1 : 0;
+            const char* thread_name = buffer->thread_name.load();
+
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"" << (thread_name != nullptr ? thread_name : "thread")
+                << " " << buffer->tid << (first > 0 ? " (" + std::to_string(first) + " older spans overwritten)" : "") << "\"}}";
+
+            for (size_t i = first; i < count; i++) {
+                TraceEvent event = buffer->events[i % TRACE_BUFFER_EVENTS];
+
+                // The thread may have come round to this slot while it was copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (buffer->count.load(std::memory_order_relaxed) >= i + TRACE_BUFFER_EVENTS) continue;
+
+                out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                    << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us;
+
+                if (event.arg_name != nullptr) {
+                    out << ",\"args\":{\"" << event.arg_name << "\":" << event.arg << "}";
+                }
+
+                out << "}";
+            }
+        }
+
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+// Records the time from its construction to the end of the scope
+class TraceSpan {
+private:
+    const char* name;
+    const char* arg_name;
+    long long arg;
+    long long start_us;
+
+public:
+    TraceSpan(const char* name, const char* arg_name = nullptr, long long arg = 0)
+        : name(name), arg_name(arg_name), arg(arg), start_us(Trace::get().nowUs()) {}
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        Trace& trace = Trace::get();
+        trace.record(name, arg_name, arg, start_us, trace.nowUs());
+    }
+};
+
+#define CHAT_TRACE_JOIN2(a, b) a##b
+#define CHAT_TRACE_JOIN(a, b) CHAT_TRACE_JOIN2(a, b)
+#define CHAT_TRACE_SPAN(name) TraceSpan CHAT_TRACE_JOIN(chat_trace_span_, __LINE__)(name)
+#define CHAT_TRACE_SPAN_ARG(name, arg_name, arg) TraceSpan CHAT_TRACE_JOIN(chat_trace_span_, __LINE__)(name, arg_name, static_cast<long long>(arg))
+#define CHAT_TRACE_THREAD(name) Trace::get().nameThread(name)
+
+inline bool traceAvailable() {
+    return true;
+}
+
+inline bool writeTrace(const std::string& filename) {
+    return Trace::get().write(filename);
+}
+
+#else
+
+#define CHAT_TRACE_SPAN(name)
+#define CHAT_TRACE_SPAN_ARG(name, arg_name, arg)
+#define CHAT_TRACE_THREAD(name)
+
+// False when the chat was built without FASTDDS_CHAT_TRACE
+inline bool traceAvailable() {
+    return false;
+}
+
+inline bool writeTrace(const std::string&) {
+    return false;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file TransportProfile.hpp
+ */
+
+#ifndef TRANSPORTPROFILE_H
+#define TRANSPORTPROFILE_H
+
+#include "ChatConfig.hpp"
+
+#include <memory>
+#include <string>
+
+#include <fastdds/dds/domain/qos/DomainParticipantQos.hpp>
+#include <fastdds/rtps/transport/TCPv4TransportDescriptor.hpp>
+#include <fastdds/utils/IPLocator.hpp>
+
+using namespace eprosima::fastdds::dds;
+
+// Fast DDS metatraffic unicast port of the first participant in a domain: 7400 + 250 * domain + 10 + 2
+inline uint16_t udpPeerPort(uint32_t domain_id) {
+    return static_cast<uint16_t>(7412 + 250 * domain_id);
+}
+
+// Fast DDS user multicast port of a domain: 7400 + 250 * domain + 1
+inline uint16_t udpMulticastPort(uint32_t domain_id) {
+    return static_cast<uint16_t>(7401 + 250 * domain_id);
+}
+
+// Locator of a remote peer or discovery server for the selected transport
+inline eprosima::fastdds::rtps::Locator_t makeLocator(const std::string& ip, uint16_t port, const ChatConfig& config) {
+    eprosima::fastdds::rtps::Locator_t locator;
+
+    if (config.use_tcp) {
+        locator.kind = LOCATOR_KIND_TCPv4;
+        eprosima::fastdds::rtps::IPLocator::setIPv4(locator, ip);
+        eprosima::fastdds::rtps::IPLocator::setPhysicalPort(locator, port);
+        eprosima::fastdds::rtps::IPLocator::setLogicalPort(locator, port);
+    }
+    else {
+        eprosima::fastdds::rtps::IPLocator::setIPv4(locator, ip);
+        locator.port = port;
+    }
+
+    return locator;
+}
+
+// Port peers from ip_list.txt are expected on when a line has no ":port"
+inline uint16_t defaultPeerPort(const ChatConfig& config, uint32_t domain_id) {
+    if (config.peer_port != 0) return config.peer_port;
+    if (!config.use_tcp) return udpPeerPort(domain_id);
+
+    return config.tcp_port != 0 ? config.tcp_port : DEFAULT_TCP_PORT;
+}
+
+// Replaces the builtin UDP/SHM transports with TCP when --tcp is used.
+// Only one side of a NAT has to listen, the other side just connects.
+inline void applyTransport(DomainParticipantQos& participantQos, const ChatConfig& config) {
+    if (!config.use_tcp) return;
+
+    std::shared_ptr<eprosima::fastdds::rtps::TCPv4TransportDescriptor> tcp =
+        std::make_shared<eprosima::fastdds::rtps::TCPv4TransportDescriptor>();
+
+    if (config.tcp_port != 0) {
+        tcp->add_listener_port(config.tcp_port);
+    }
+
+    if (!config.wan_address.empty()) {
+        tcp->set_WAN_address(config.wan_address);
+    }
+
+    // NAT tables drop idle connections, keep them warm
+    if (config.qos_profile == "wan") {
+        tcp->keep_alive_frequency_ms = 5000;
+        tcp->keep_alive_timeout_ms = 15000;
+    }
+
+    participantQos.transport().use_builtin_transports = false;
+    participantQos.transport().user_transports.push_back(tcp);
+}
+
+#endif
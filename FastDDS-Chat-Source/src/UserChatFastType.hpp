@@ -0,0 +1,239 @@
+/**
+ * @file UserChatFastType.hpp
+ */
+
+#ifndef USERCHATFASTTYPE_H
+#define USERCHATFASTTYPE_H
+
+#include "UserChatPubSubTypes.hpp"
+#include "UserChatTypeObjectSupport.hpp"
+#include "ChatConfig.hpp"
+#include "Trace.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fastdds/dds/topic/TopicDataType.hpp>
+#include <fastdds/rtps/common/InstanceHandle.hpp>
+#include <fastdds/rtps/common/SerializedPayload.hpp>
+
+// Hand-written type support for UserChat, registered instead of UserChatPubSubType with
+// "serializer = fast". It writes the four fields straight into the payload and works out the
+// size with a few additions instead of a calculator pass, but produces the same bytes as the
+// generated code, so the two interoperate:
+//   XCDRv1 (PLAIN_CDR):     [00 01 00 00] index, username, message, picture
+//   XCDRv2 (DELIMIT_CDR2):  [00 09 00 00] DHEADER (body length), then the same fields
+// Strings are a u32 length (counting the '\0'), the text and a '\0', then padding to 4 bytes.
+// Anything else (big endian peers, other encodings) is handed to the generated type.
+class UserChatFastPubSubType : public eprosima::fastdds::dds::TopicDataType
+{
+private:
+    UserChatPubSubType generated_;
+
+    // Encapsulation identifiers from the DDS-XTypes spec
+    static const uint16_t ENCAPSULATION_CDR_LE = 0x0001;
+    static const uint16_t ENCAPSULATION_D_CDR2_LE = 0x0009;
+
+    static size_t align4(size_t offset) {
+        return (offset + 3) & ~static_cast<size_t>(3);
+    }
+
+    // Bytes after the encapsulation header, not counting the DHEADER
+    static size_t bodySize(const UserChat& sample) {
+        size_t size = 4;
+        size = align4(size + 4 + sample.username().size() + 1);
+        size = align4(size + 4 + sample.message().size() + 1);
+        return size + 4;
+    }
+
+    static void putU32(unsigned char* out, uint32_t value) {
+        out[0] = static_cast<unsigned char>(value & 0xff);
+        out[1] = static_cast<unsigned char>((value >> 8) & 0xff);
+        out[2] = static_cast<unsigned char>((value >> 16) & 0xff);
+        out[3] = static_cast<unsigned char>((value >> 24) & 0xff);
+    }
+
+    static uint32_t getU32(const unsigned char* in) {
+        return static_cast<uint32_t>(in[0])
+            | (static_cast<uint32_t>(in[1]) << 8)
+            | (static_cast<uint32_t>(in[2]) << 16)
+            | (static_cast<uint32_t>(in[3]) << 24);
+    }
+
+    // Writes length, text, '\0' and padding at out + pos (pos counts from the end of the header)
+    static size_t putString(unsigned char* out, size_t pos, const std::string& str) {
+        putU32(out + pos, static_cast<uint32_t>(str.size() + 1));
+        std::memcpy(out + pos + 4, str.data(), str.size());
+        pos += 4 + str.size();
+
+        size_t end = align4(pos + 1);
+        std::memset(out + pos, 0, end - pos);
+        return end;
+    }
+
+    static bool getString(const unsigned char* in, size_t& pos, size_t end, std::string& str) {
+        if (pos + 4 > end) return false;
+
+        uint32_t length = getU32(in + pos);
+        pos += 4;
+
+        if (length > end - pos) return false;
+
+        // The '\0' is counted in the length but isn't part of the string
+        size_t text = length > 0 && in[pos + length - 1] == '\0' ? length - 1 : length;
+        str.assign(reinterpret_cast<const char*>(in + pos), text);
+        pos = align4(pos + length);
+
+        return true;
+    }
+
+public:
+    typedef UserChat type;
+
+    UserChatFastPubSubType()
+    {
+        set_name("UserChat");
+        max_serialized_type_size = generated_.max_serialized_type_size;
+        is_compute_key_provided = false;
+    }
+
+    ~UserChatFastPubSubType() override {}
+
+    bool serialize(
+            const void* const data,
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            eprosima::fastdds::dds::DataRepresentationId_t data_representation) override
+    {
+        CHAT_TRACE_SPAN("serialize");
+        const UserChat* sample = static_cast<const UserChat*>(data);
+        bool delimited = data_representation != eprosima::fastdds::dds::XCDR_DATA_REPRESENTATION;
+        size_t body = bodySize(*sample);
+        size_t total = 4 + (delimited ? 4 : 0) + body;
+
+        // The generated code refuses these too, the '\0' would end the string early on the other side
+        if (total > payload.max_size
+            || std::memchr(sample->username().data(), '\0', sample->username().size()) != nullptr
+            || std::memchr(sample->message().data(), '\0', sample->message().size()) != nullptr) {
+            return false;
+        }
+
+        // Offsets below are from the end of the encapsulation header, which is where CDR aligns from
+        unsigned char* out = reinterpret_cast<unsigned char*>(payload.data) + 4;
+        size_t pos = 0;
+
+        uint16_t encapsulation = delimited ? ENCAPSULATION_D_CDR2_LE : ENCAPSULATION_CDR_LE;
+        out[-4] = static_cast<unsigned char>(encapsulation >> 8);
+        out[-3] = static_cast<unsigned char>(encapsulation & 0xff);
+        out[-2] = 0;
+        out[-1] = 0;
+
+        if (delimited) {
+            putU32(out, static_cast<uint32_t>(body));
+            pos += 4;
+        }
+
+        putU32(out + pos, sample->index());
+        pos += 4;
+        pos = putString(out, pos, sample->username());
+        pos = putString(out, pos, sample->message());
+        putU32(out + pos, static_cast<uint32_t>(sample->picture()));
+        pos += 4;
+
+        payload.encapsulation = CDR_LE;
+        payload.length = static_cast<uint32_t>(4 + pos);
+        return true;
+    }
+
+    bool deserialize(
+            eprosima::fastdds::rtps::SerializedPayload_t& payload,
+            void* data) override
+    {
+        CHAT_TRACE_SPAN("deserialize");
+        if (payload.length < 4) return false;
+
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(payload.data) + 4;
+        uint16_t encapsulation = static_cast<uint16_t>((in[-4] << 8) | in[-3]);
+
+        if (encapsulation != ENCAPSULATION_CDR_LE && encapsulation != ENCAPSULATION_D_CDR2_LE) {
+            return generated_.deserialize(payload, data);
+        }
+
+        UserChat* sample = static_cast<UserChat*>(data);
+        size_t pos = 0;
+        size_t end = payload.length - 4;
+
+        if (encapsulation == ENCAPSULATION_D_CDR2_LE) {
+            if (end < 4) return false;
+
+            // A newer appendable UserChat may add fields after picture, the DHEADER skips them
+            size_t body = getU32(in);
+            if (body > end - 4) return false;
+
+            pos = 4;
+            end = 4 + body;
+        }
+
+        if (pos + 4 > end) return false;
+        sample->index(getU32(in + pos));
+        pos += 4;
+
+        if (!getString(in, pos, end, sample->username())) return false;
+        if (!getString(in, pos, end, sample->message())) return false;
+
+        if (pos + 4 > end) return false;
+        sample->picture(static_cast<int32_t>(getU32(in + pos)));
+
+        payload.encapsulation = CDR_LE;
+        return true;
+    }
+
+    uint32_t calculate_serialized_size(
+            const void* const data,
+            eprosima::fastdds::dds::DataRepresentationId_t data_representation) override
+    {
+        bool delimited = data_representation != eprosima::fastdds::dds::XCDR_DATA_REPRESENTATION;
+        return static_cast<uint32_t>(4 + (delimited ? 4 : 0) + bodySize(*static_cast<const UserChat*>(data)));
+    }
+
+    bool compute_key(
+            eprosima::fastdds::rtps::SerializedPayload_t&,
+            eprosima::fastdds::rtps::InstanceHandle_t&,
+            bool = false) override
+    {
+        return false;
+    }
+
+    bool compute_key(
+            const void* const,
+            eprosima::fastdds::rtps::InstanceHandle_t&,
+            bool = false) override
+    {
+        return false;
+    }
+
+    void* create_data() override
+    {
+        return reinterpret_cast<void*>(new UserChat());
+    }
+
+    void delete_data(void* data) override
+    {
+        delete(reinterpret_cast<UserChat*>(data));
+    }
+
+    // Same TypeObject as the generated type, so peers see one type whichever side uses this
+    void register_type_object_representation() override
+    {
+        register_UserChat_type_identifier(type_identifiers_);
+    }
+};
+
+// Type support picked by the "serializer" option
+inline eprosima::fastdds::dds::TopicDataType* createUserChatType(const ChatConfig& config) {
+    if (config.serializer == "fast") return new UserChatFastPubSubType();
+
+    return new UserChatPubSubType();
+}
+
+#endif
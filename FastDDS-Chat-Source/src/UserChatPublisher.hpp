@@ -2,14 +2,29 @@
  * @file UserChatPublisher.hpp
  */
 
-#include "UserChatPubSubTypes.hpp";
+#ifndef USERCHATPUBLISHER_H
+#define USERCHATPUBLISHER_H
+
+#include "UserChatPubSubTypes.hpp"
 #include "Globals.hpp"
+#include "ChatHistory.hpp"
+#include "ChatParticipant.hpp"
+#include "QosProfiles.hpp"
+#include "ConsoleWriter.hpp"
+#include "Reactor.hpp"
+#include "OutboxLog.hpp"
+#include "HistorySync.hpp"
+#include "DeliveryReceipts.hpp"
+#include "Trace.hpp"
+#include <algorithm>
 #include <chrono>
-#include <thread>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <atomic>
 #include <ctime>
-#include <fstream> 
 
 #include <fastdds/dds/domain/DomainParticipant.hpp>
 #include <fastdds/dds/domain/DomainParticipantFactory.hpp>
@@ -18,44 +33,84 @@
 #include <fastdds/dds/publisher/Publisher.hpp>
 #include <fastdds/dds/topic/TypeSupport.hpp>
 
-#include <fastdds/rtps/transport/TCPv4TransportDescriptor.hpp>
-
 using namespace eprosima::fastdds::dds;
 
+// Messages waiting on the reactor for one contact before new ones are dropped
+const size_t SEND_OUTBOX_LIMIT = 1000;
+
+// How soon a full send queue is tried again
+const unsigned int SEND_RETRY_MS = 50;
+
+enum PublishResult {
+    PUBLISH_OK,
+    PUBLISH_QUEUE_FULL,     // Too many messages the other user hasn't acknowledged yet, try again later
+    PUBLISH_NOT_MATCHED,    // Nobody is listening, the message was dropped
+    PUBLISH_ERROR,
+};
+
+struct SendQueueStats {
+    uint32_t depth;         // Written but not yet acknowledged by the reader (from the writer)
+    uint32_t high_water;    // Largest depth seen
+    uint64_t drops;         // Messages that were never sent
+    size_t outbox;          // Messages still waiting for the reactor
+};
+
 class UserChatPublisher {
 private:
     UserChat user_message_;
+    UserChat urgent_message_;           // Numbered on its own, from 1 every run
     DomainParticipant* participant_;
     Publisher* publisher_;
     Topic* topic_;
     DataWriter* writer_;
-    TypeSupport type_;
+    Topic* urgent_topic_;
+    DataWriter* urgent_writer_;         // Priority lane, see applyUrgentQos()
 
-    std::atomic<bool> active;           // Whether Publisher is accepting input
     std::atomic<bool> status;           // Whether Publisher is online or not (matched with subscriber)
-    std::vector<std::string>* history;  // Ongoing history of chat
+    std::atomic<bool> stopped;          // Set when the user is removed, queued messages are dropped
+    ChatHistory* history;               // Ongoing history of chat
+
+    std::deque<std::string> outbox;     // Messages waiting for the reactor to publish them
+    std::mutex outbox_mtx;
+    bool flush_posted;                  // Whether a flushOutbox() is already waiting on the reactor
 
     std::string username;
     std::string topic_name;
 
+    OutboxLog log;                      // Everything published, for peers that missed some of it
+    std::string log_file;               // Empty for no log, indexes then start at 1
+    std::atomic<bool> log_flush_posted; // A flush of the log is waiting on the reactor
+    std::unique_ptr<SyncReplier> sync;
+
+    std::unique_ptr<ReceiptReader> receipts;
+    ReceiptReader::ReceiptCallback on_receipt;
+    std::atomic<uint32_t> sent_index;   // Index of the newest published message
+    std::atomic<uint32_t> acked_index;  // Every message up to this index was acknowledged to the writer
+
+    std::mutex publish_mtx;             // Guards user_message_ and the log
+    std::mutex urgent_mtx;              // Guards urgent_message_, so urgent writes never wait for a normal one
+    std::atomic<uint32_t> high_water;
+    std::atomic<uint64_t> drops;
+    std::atomic<unsigned long long> retry_timer;
+
     class PubListener : public DataWriterListener
     {
     private:
         UserChatPublisher* publisher_;
     public:
-        PubListener(UserChatPublisher* publisher) : matched_(0), publisher_(publisher) {}
+        PubListener(UserChatPublisher* publisher) : publisher_(publisher), matched_(0) {}
         ~PubListener() override {}
 
         void on_publication_matched(DataWriter*, const PublicationMatchedStatus& info) override {
             if (info.current_count_change == 1)
             {
-                matched_ = info.total_count;
+                matched_ = info.current_count;
                 //std::cout << "Publisher matched." << std::endl;
                 publisher_->setStatus(true);
             }
             else if (info.current_count_change == -1)
             {
-                matched_ = info.total_count;
+                matched_ = info.current_count;
                 //std::cout << "Publisher unmatched." << std::endl;
                 publisher_->setStatus(false);
             }
@@ -67,27 +122,56 @@ private:
         std::atomic_int matched_;
     } listener_;
 
+    class UrgentListener : public DataWriterListener
+    {
+    public:
+        UrgentListener() : matched_(0) {}
+        ~UrgentListener() override {}
+
+        void on_publication_matched(DataWriter*, const PublicationMatchedStatus& info) override {
+            matched_ = info.current_count;
+        }
+
+        std::atomic_int matched_;
+    } urgent_listener_;
+
 public:
-    UserChatPublisher(std::string topic_name, std::string name, std::vector<std::string>* curr_history)
+    UserChatPublisher(std::string topic_name, std::string name, ChatHistory* curr_history)
         : participant_(nullptr)
         , publisher_(nullptr)
         , topic_(nullptr)
         , writer_(nullptr)
-        , type_(new UserChatPubSubType())
-        , listener_(this)
+        , urgent_topic_(nullptr)
+        , urgent_writer_(nullptr)
         , history(curr_history)
+        , flush_posted(false)
+        , listener_(this)
     {
         this->topic_name = topic_name;
-        this->active = false;
         this->status = false;
+        this->stopped = false;
+        this->sent_index = 0;
+        this->acked_index = 0;
+        this->log_flush_posted = false;
+        this->high_water = 0;
+        this->drops = 0;
+        this->retry_timer = 0;
         this->username = name;
+        this->log_file = "./ChatLogs/" + topic_name + ".outbox";
     }
 
     virtual ~UserChatPublisher() {
+        sync.reset();
+        receipts.reset();
+
         if (writer_ != nullptr)
         {
             publisher_->delete_datawriter(writer_);
         }
+        if (urgent_writer_ != nullptr)
+        {
+            publisher_->delete_datawriter(urgent_writer_);
+        }
         if (publisher_ != nullptr)
         {
             participant_->delete_publisher(publisher_);
@@ -96,93 +180,313 @@ public:
         {
             participant_->delete_topic(topic_);
         }
-        DomainParticipantFactory::get_instance()->delete_participant(participant_);
+        if (urgent_topic_ != nullptr)
+        {
+            participant_->delete_topic(urgent_topic_);
+        }
+        if (participant_ != nullptr)
+        {
+            ChatParticipant::release();
+        }
     }
 
     bool init()
     {
-        user_message_.index(0);
+        // Carries on counting from the last run, receivers use the index to spot gaps and copies
+        if (!log_file.empty()) log.open(log_file);
+
+        user_message_.index(log.lastIndex());
         user_message_.username(username);
+        sent_index = user_message_.index();
+        acked_index = sent_index.load();
 
-        DomainParticipantQos participantQos;
-        participantQos.name("Participant_publisher");
+        urgent_message_.index(0);
+        urgent_message_.username(username);
 
-        // Parse for IPs, comment out all of this to use FastDDS Locally
-        
-        std::ifstream inputFile("./ip_list.txt");
+        participant_ = ChatParticipant::acquire();
 
-        if (!inputFile) {
-            std::cerr << "Could not open file!" << std::endl;
+        if (participant_ == nullptr)
+        {
+            return false;
         }
 
-        std::string line;
+        // Creates topic named after username to publish from
+        topic_ = participant_->create_topic(topic_name, "UserChat", TOPIC_QOS_DEFAULT);
 
-        // Skips first two lines
-        std::getline(inputFile, line);
-        std::getline(inputFile, line);
+        if (topic_ == nullptr)
+        {
+            return false;
+        }
+
+        publisher_ = participant_->create_publisher(chatPublisherQos(chatConfig()), nullptr);
 
-        // Loops through IPs
-        while (std::getline(inputFile, line)) {
-            eprosima::fastdds::rtps::Locator_t locator;
-            eprosima::fastdds::rtps::IPLocator::setIPv4(locator, line);
-            locator.port = 7412;
-            participantQos.wire_protocol().builtin.initialPeersList.push_back(locator);
+        if (publisher_ == nullptr)
+        {
+            return false;
         }
 
-        inputFile.close();
-        // End IP stuff
+        DataWriterQos writerQos = DATAWRITER_QOS_DEFAULT;
+        applyQosProfile(writerQos, publisher_, chatConfig());
+        applySendQueue(writerQos, chatConfig());
+        applyDataRepresentation(writerQos, chatConfig());
 
-        participant_ = DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+        writer_ = publisher_->create_datawriter(topic_, writerQos, &listener_);
 
-        if (participant_ == nullptr)
+        if (writer_ == nullptr)
         {
             return false;
         }
 
-        type_.register_type(participant_);
-
-        // Creates topic named after username to publish from
-        topic_ = participant_->create_topic(topic_name, "UserChat", TOPIC_QOS_DEFAULT);
+        urgent_topic_ = participant_->create_topic(topic_name + "_urgent", "UserChat", TOPIC_QOS_DEFAULT);
 
-        if (topic_ == nullptr)
+        if (urgent_topic_ == nullptr)
         {
             return false;
         }
 
-        publisher_ = participant_->create_publisher(PUBLISHER_QOS_DEFAULT, nullptr);
+        DataWriterQos urgentQos = DATAWRITER_QOS_DEFAULT;
+        applyUrgentQos(urgentQos, writerQos.publish_mode());
+        applyDataRepresentation(urgentQos, chatConfig());
 
-        if (publisher_ == nullptr)
+        urgent_writer_ = publisher_->create_datawriter(urgent_topic_, urgentQos, &urgent_listener_);
+
+        if (urgent_writer_ == nullptr)
         {
             return false;
         }
 
-        writer_ = publisher_->create_datawriter(topic_, DATAWRITER_QOS_DEFAULT, &listener_);
+        sync.reset(new SyncReplier(topic_name, username, &log));
+        receipts.reset(new ReceiptReader(topic_name, on_receipt));
 
-        if (writer_ == nullptr)
+        return sync->init(participant_) && receipts->init(participant_);
+    }
+
+    // Publishes one message and adds it to the history without ever blocking. Safe from any thread.
+    PublishResult tryPublish(const std::string& message)
+    {
+        if (listener_.matched_ == 0)
+        {
+            drops++;
+            return PUBLISH_NOT_MATCHED;
+        }
+
+        CHAT_TRACE_SPAN("publish");
+        std::lock_guard<std::mutex> lock(publish_mtx);
+
+        std::string timestamp = timestampNow();
+
+        user_message_.index(user_message_.index() + 1);
+        user_message_.message(message);
+
+        eprosima::fastdds::dds::ReturnCode_t ret;
+        {
+            // Serializes and, for synchronous writers, hands the message to the transport
+            CHAT_TRACE_SPAN_ARG("write", "index", user_message_.index());
+            ret = writer_->write(&user_message_);
+        }
+
+        if (ret != eprosima::fastdds::dds::RETCODE_OK)
+        {
+            user_message_.index(user_message_.index() - 1);
+
+            // The writer's history is full of messages the reader hasn't acknowledged
+            if (ret == eprosima::fastdds::dds::RETCODE_TIMEOUT || ret == eprosima::fastdds::dds::RETCODE_OUT_OF_RESOURCES)
+            {
+                uint32_t full = static_cast<uint32_t>(std::max(chatConfig().send_queue, 0));
+                if (full > high_water) high_water = full;
+
+                return PUBLISH_QUEUE_FULL;
+            }
+
+            drops++;
+            return PUBLISH_ERROR;
+        }
+
+        log.append(user_message_.index(), message);
+        sent_index = user_message_.index();
+
+        // One flush for everything published before the reactor gets to it
+        if (!log_flush_posted.exchange(true)) {
+            Reactor::get().post([this]() {
+                log_flush_posted = false;
+                log.flush();
+            });
+        }
+
+        uint32_t depth = queueDepth();
+        if (depth > high_water) high_water = depth;
+
+        std::string str = user_message_.username() + " (" + timestamp + ")" + ": " + message;
+        history->push_back(str);
+        return PUBLISH_OK;
+    }
+
+    // Writes straight away from the calling thread instead of queueing behind the outbox.
+    // The priority lane numbers its messages on its own, so one can overtake queued normal
+    // messages without the other side taking it for a gap. They aren't kept in the outbox log,
+    // so history sync doesn't bring them. Peers without a priority lane get it through the normal writer.
+    PublishResult sendUrgent(const std::string& message)
+    {
+        if (urgent_listener_.matched_ == 0)
+        {
+            return tryPublish(message);
+        }
+
+        CHAT_TRACE_SPAN("publish");
+        std::lock_guard<std::mutex> lock(urgent_mtx);
+
+        std::string timestamp = timestampNow();
+
+        urgent_message_.index(urgent_message_.index() + 1);
+        urgent_message_.message(message);
+
+        eprosima::fastdds::dds::ReturnCode_t ret;
         {
+            CHAT_TRACE_SPAN_ARG("write", "index", urgent_message_.index());
+            ret = urgent_writer_->write(&urgent_message_);
+        }
+
+        if (ret != eprosima::fastdds::dds::RETCODE_OK)
+        {
+            urgent_message_.index(urgent_message_.index() - 1);
+
+            if (ret == eprosima::fastdds::dds::RETCODE_TIMEOUT || ret == eprosima::fastdds::dds::RETCODE_OUT_OF_RESOURCES)
+            {
+                return PUBLISH_QUEUE_FULL;
+            }
+
+            drops++;
+            return PUBLISH_ERROR;
+        }
+
+        history->push_back(username + " (" + timestamp + ")" + ": " + URGENT_MARK + message);
+        return PUBLISH_OK;
+    }
+
+    // Queues a message for the reactor thread, never blocks the caller. Returns false if the
+    // outbox is full (the other user has stopped reading) and the message was dropped.
+    bool send(const std::string& message) {
+        std::lock_guard<std::mutex> lock(outbox_mtx);
+
+        if (outbox.size() >= SEND_OUTBOX_LIMIT) {
+            drops++;
             return false;
         }
+
+        outbox.push_back(message);
+
+        if (!flush_posted) {
+            flush_posted = true;
+            Reactor::get().post([this]() { flushOutbox(); });
+        }
+
         return true;
     }
 
-    bool publish()
-    {
-        if (listener_.matched_ > 0)
+    void flushOutbox() {
+        CHAT_TRACE_SPAN("flush_outbox");
+        std::deque<std::string> pending;
         {
-            user_message_.index(user_message_.index() + 1);
-            writer_->write(&user_message_);
-            return true;
+            std::lock_guard<std::mutex> lock(outbox_mtx);
+            pending.swap(outbox);
+            flush_posted = false;
         }
-        return false;
+
+        while (!pending.empty()) {
+            if (stopped.load()) return;
+
+            PublishResult result = tryPublish(pending.front());
+
+            if (result == PUBLISH_QUEUE_FULL) {
+                // The reader is behind, keep the rest in order and try again shortly
+                std::lock_guard<std::mutex> lock(outbox_mtx);
+                outbox.insert(outbox.begin(), pending.begin(), pending.end());
+
+                if (!flush_posted && !stopped.load()) {
+                    flush_posted = true;
+                    retry_timer = Reactor::get().schedule(std::chrono::milliseconds(SEND_RETRY_MS), [this]() { flushOutbox(); });
+                }
+                return;
+            }
+
+            if (result == PUBLISH_NOT_MATCHED) {
+                ConsoleWriter::get().writeLine("Other user is offline now. Message discarded.");
+            }
+            else if (result == PUBLISH_ERROR) {
+                ConsoleWriter::get().writeLine("Error sending message. Message discarded.");
+            }
+
+            pending.pop_front();
+        }
+    }
+
+    // Messages the writer still holds for a reliable reader. Fast DDS only says whether all of
+    // them are acknowledged, so everything written since it last did counts, at most send_queue
+    // (the writer's KEEP_ALL history can't hold more).
+    uint32_t queueDepth() {
+        uint32_t sent = sent_index.load();
+
+        if (writer_ != nullptr &&
+            writer_->wait_for_acknowledgments(eprosima::fastdds::dds::Duration_t(0, 0)) == eprosima::fastdds::dds::RETCODE_OK) {
+            acked_index = sent;
+        }
+
+        uint32_t acked = acked_index.load();
+        uint32_t depth = sent > acked ? sent - acked : 0;
+
+        if (chatConfig().send_queue > 0) {
+            depth = std::min(depth, static_cast<uint32_t>(chatConfig().send_queue));
+        }
+
+        return depth;
     }
 
-    // Whether to get input from user or not
-    void setActive(bool set) {
-        active.store(set);
+    SendQueueStats getQueueStats() {
+        SendQueueStats stats;
+        stats.depth = queueDepth();
+        stats.high_water = high_water.load();
+        stats.drops = drops.load();
+        {
+            std::lock_guard<std::mutex> lock(outbox_mtx);
+            stats.outbox = outbox.size();
+        }
+
+        if (stats.depth > stats.high_water) stats.high_water = stats.depth;
+        return stats;
+    }
+
+    // Where the outbox log is kept instead of ChatLogs, "" for none. Set before init().
+    void setLogFile(const std::string& filename) {
+        log_file = filename;
     }
 
-    bool getActive() {
-        return active.load();
+    // Runs on a Fast DDS thread when the other user's receipt changes, set before init()
+    void setReceiptCallback(ReceiptReader::ReceiptCallback callback) {
+        on_receipt = callback;
+    }
+
+    uint32_t getSentIndex() const {
+        return sent_index.load();
+    }
+
+    // Every message up to this index reached the other user
+    uint32_t getDeliveredIndex() const {
+        return receipts ? receipts->getDelivered() : 0;
+    }
+
+    // Every message up to this index was shown to the other user
+    uint32_t getReadIndex() const {
+        return receipts ? receipts->getRead() : 0;
+    }
+
+    // The chat writers created by init(), for their statistics
+    std::vector<eprosima::fastdds::rtps::GUID_t> getWriterGuids() const {
+        std::vector<eprosima::fastdds::rtps::GUID_t> guids;
+
+        if (writer_ != nullptr) guids.push_back(writer_->guid());
+        if (urgent_writer_ != nullptr) guids.push_back(urgent_writer_->guid());
+
+        return guids;
     }
 
     // Signals online or offline
@@ -194,49 +498,15 @@ public:
         return status.load();
     }
 
-    void run()
-    {
-        uint32_t samples_sent = 0;
-        while (true)
-        {
-            if (std::find(endThreadSignal.begin(), endThreadSignal.end(), topic_name) != endThreadSignal.end()) break;
-            //if (std::find(end_signal->begin(), end_signal->end(), topic_name) != end_signal->end()) break;
-
-            if (getActive()) {
-                if (!getStatus()) {
-                    std::cout << std::endl << "Other user is offline now. Last message discarded. Press any key to go back to main ui...";
-                    getchar();
-
-                    setActive(false);
-                }
-                else if (publish())
-                {
-                    std::string message = "";
-                    std::string exit = "/exit";
-
-                    std::getline(std::cin, message, '\n');
-
-                    if (message == exit) {
-                        setActive(false);
-
-                        message = "";
-                    }
-                    else if (getStatus()){
-                        auto now = std::chrono::system_clock::now();
-                        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-                        std::tm local_time = *std::localtime(&now_time);
-                        std::string timestamp = std::asctime(&local_time);
-                        timestamp.pop_back();
-
-                        user_message_.message(message);
-
-                        std::string str = user_message_.username() + " (" + timestamp + ")" + ": " + message;
-                        history->push_back(str);
-                    }
-                }
-            }
+    // Drops whatever is still queued, Reactor::sync() afterwards before deleting
+    void stop() {
+        std::lock_guard<std::mutex> lock(outbox_mtx);
+        stopped.store(true);
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        if (retry_timer.load() != 0) {
+            Reactor::get().cancel(retry_timer.load());
         }
     }
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
@@ -2,11 +2,24 @@
  * @file UserChatSubscriber.hpp
  */
 
-#include "UserChatPubSubTypes.hpp";
+#ifndef USERCHATSUBSCRIBER_H
+#define USERCHATSUBSCRIBER_H
+
+#include "UserChatPubSubTypes.hpp"
 #include "Globals.hpp"
+#include "ChatHistory.hpp"
+#include "ChatParticipant.hpp"
+#include "QosProfiles.hpp"
+#include "ConsoleWriter.hpp"
+#include "TaskPool.hpp"
+#include "HistorySync.hpp"
+#include "DeliveryReceipts.hpp"
+#include "Trace.hpp"
 #include <chrono>
-#include <thread>
 #include <ctime>
+#include <memory>
+#include <set>
+#include <vector>
 
 #include <fastdds/dds/domain/DomainParticipant.hpp>
 #include <fastdds/dds/domain/DomainParticipantFactory.hpp>
@@ -17,8 +30,6 @@
 #include <fastdds/dds/subscriber/Subscriber.hpp>
 #include <fastdds/dds/topic/TypeSupport.hpp>
 
-#include <fastdds/rtps/transport/TCPv4TransportDescriptor.hpp>
-
 using namespace eprosima::fastdds::dds;
 
 class UserChatSubscriber
@@ -28,19 +39,20 @@ private:
     Subscriber* subscriber_;
     DataReader* reader_;
     Topic* topic_;
-    TypeSupport type_;
+    DataReader* urgent_reader_;         // Priority lane of the other user
+    Topic* urgent_topic_;
 
     std::string topic_name;
-    std::vector<std::string>* history;  // Ongoing history of chat
+    ChatHistory* history;               // Ongoing history of chat
     std::vector<std::string>* curr_tab; // Tells subscriber if user is tabbed into chat to output messages
 
     class SubListener : public DataReaderListener
     {
     private:
         UserChatSubscriber* subscriber_;
-        std::string last_received_message;
+        bool urgent_;
     public:
-        SubListener(UserChatSubscriber* subscriber) : samples_(0), subscriber_(subscriber) { last_received_message = ""; }
+        SubListener(UserChatSubscriber* subscriber, bool urgent) : subscriber_(subscriber), urgent_(urgent), samples_(0) {}
         ~SubListener() override {}
 
         void on_subscription_matched(DataReader*, const SubscriptionMatchedStatus& info) override
@@ -58,42 +70,18 @@ private:
 
         void on_data_available(DataReader* reader) override
         {
+            CHAT_TRACE_SPAN("on_data_available");
             SampleInfo info;
-            if (reader->take_next_sample(&user_message_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
+
+            // Only copies samples out, the rest of the work is done on the task pool so the DDS thread returns right away
+            while (reader->take_next_sample(&user_message_, &info) == eprosima::fastdds::dds::RETCODE_OK) {
                 if (info.valid_data)
                 {
                     samples_++;
 
                     if (user_message_.username() != "" && user_message_.message() != "") {
-                        auto now = std::chrono::system_clock::now();
-                        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-                        std::tm local_time = *std::localtime(&now_time);
-                        std::string timestamp = std::asctime(&local_time);
-                        timestamp.pop_back(); // gets rid of \n
-
-                        std::string str = user_message_.username() + ": " + user_message_.message();
-                        //std::string message = user_message_.username() + " (" + timestamp + ")" + ": " + user_message_.message();
-                        std::vector<std::string>* curr_history = subscriber_->getHistory();
-                        std::vector<std::string>* curr_tab = subscriber_->getCurrTab();
-
-                        if (last_received_message == "") {
-                            if (curr_tab->at(0) == "in" && curr_tab->at(1) == subscriber_->getTopicName()) {
-                                std::cout << user_message_.username() + " (" + timestamp + ")" + ": ";
-                                std::cout << user_message_.message() << std::endl;
-                            }
-
-                            curr_history->push_back(str);
-                            last_received_message = str;
-                        }
-                        else if (last_received_message != str) {
-                            if (curr_tab->at(0) == "in" && curr_tab->at(1) == subscriber_->getTopicName()) {
-                                std::cout << user_message_.username() + " (" + timestamp + ")" + ": ";
-                                std::cout << user_message_.message() << std::endl;
-                            }
-
-                            curr_history->push_back(str);
-                            last_received_message = str;
-                        }
+                        subscriber_->process(user_message_.index(), info.publication_handle,
+                            std::move(user_message_.username()), std::move(user_message_.message()), urgent_);
                     }
                 }
             }
@@ -103,18 +91,107 @@ private:
 
         std::atomic_int samples_;
     }
-    listener_;
+    listener_, urgent_listener_;
+
+    Strand strand;                      // Keeps this chat's messages in order on the task pool
+
+    // Which indexes arrived, only touched on the strand
+    uint32_t last_seen;                 // Every index up to this one arrived
+    std::set<uint32_t> seen_ahead;      // Indexes that arrived after a gap
+    uint32_t sync_target;               // Last index the running sync will bring
+    uint32_t last_read;                 // Every index up to this one was shown to the user
+    eprosima::fastdds::rtps::InstanceHandle_t live_writer;
+
+    // The priority lane has its own numbering and no history sync, so only copies are dropped
+    uint32_t urgent_seen;               // Newest urgent index that arrived
+    eprosima::fastdds::rtps::InstanceHandle_t urgent_writer;
+
+    std::unique_ptr<SyncRequester> sync;
+    std::unique_ptr<ReceiptSender> receipts;
+
+    // On the strand. A new urgent writer (the other user restarted) numbers from 1 again.
+    void processUrgent(uint32_t index, const eprosima::fastdds::rtps::InstanceHandle_t& writer, const std::string& sender, const std::string& message) {
+        if (writer != urgent_writer) {
+            urgent_writer = writer;
+            urgent_seen = 0;
+        }
+
+        if (index <= urgent_seen) return;
+        urgent_seen = index;
+
+        deliver(sender, URGENT_MARK + message);
+    }
+
+    // Returns false if index already arrived
+    bool markSeen(uint32_t index) {
+        if (index <= last_seen || seen_ahead.count(index) > 0) return false;
+
+        if (index != last_seen + 1) {
+            seen_ahead.insert(index);
+            return true;
+        }
+
+        last_seen = index;
+
+        while (!seen_ahead.empty() && *seen_ahead.begin() == last_seen + 1) {
+            last_seen = *seen_ahead.begin();
+            seen_ahead.erase(seen_ahead.begin());
+        }
+
+        return true;
+    }
+
+    void deliver(const std::string& sender, const std::string& message) {
+        std::string timestamp = timestampNow();
+
+        std::string str = sender + ": " + message;
+
+        if (isChatOpen(curr_tab, topic_name)) {
+            ConsoleWriter::get().writeLine(sender + " (" + timestamp + ")" + ": " + message);
+            last_read = last_seen;
+        }
+
+        history->push_back(str);
+    }
+
+    // The other user can be asked now, get whatever came after last_seen
+    void syncFromPeer() {
+        strand.post([this]() {
+            sync_target = last_seen;
+            sync->request(last_seen);
+        });
+    }
+
+    void syncBatch(uint32_t first, uint32_t last, const std::string& sender, const std::vector<std::string>& messages) {
+        strand.post([this, first, last, sender, messages]() {
+            if (last > sync_target) sync_target = last;
+
+            for (size_t i = 0; i < messages.size(); i++) {
+                if (markSeen(first + static_cast<uint32_t>(i))) {
+                    deliver(sender, messages[i]);
+                }
+            }
+
+            receipts->update(last_seen, last_read);
+        });
+    }
 
 public:
-    UserChatSubscriber(std::string topic_name, std::vector<std::string>* curr_history, std::vector<std::string>* tab)
+    UserChatSubscriber(std::string topic_name, ChatHistory* curr_history, std::vector<std::string>* tab)
         : participant_(nullptr)
         , subscriber_(nullptr)
-        , topic_(nullptr)
         , reader_(nullptr)
-        , type_(new UserChatPubSubType())
-        , listener_(this)
+        , topic_(nullptr)
+        , urgent_reader_(nullptr)
+        , urgent_topic_(nullptr)
         , history(curr_history)
         , curr_tab(tab)
+        , listener_(this, false)
+        , urgent_listener_(this, true)
+        , last_seen(0)
+        , sync_target(0)
+        , last_read(0)
+        , urgent_seen(0)
     {
         this->topic_name = topic_name;
     }
@@ -125,29 +202,56 @@ public:
         {
             subscriber_->delete_datareader(reader_);
         }
+        if (urgent_reader_ != nullptr)
+        {
+            subscriber_->delete_datareader(urgent_reader_);
+        }
+
+        if (sync) sync->close();
+
+        // Messages still being processed point at the history, the sync and the receipts
+        strand.waitIdle();
+
+        sync.reset();
+        receipts.reset();
+
         if (topic_ != nullptr)
         {
             participant_->delete_topic(topic_);
         }
+        if (urgent_topic_ != nullptr)
+        {
+            participant_->delete_topic(urgent_topic_);
+        }
         if (subscriber_ != nullptr)
         {
             participant_->delete_subscriber(subscriber_);
         }
-        DomainParticipantFactory::get_instance()->delete_participant(participant_);
+        if (participant_ != nullptr)
+        {
+            ChatParticipant::release();
+        }
     }
 
     bool init()
     {
-        DomainParticipantQos participantQos;
-        participantQos.name("Participant_subscriber");
-
-        participant_ = DomainParticipantFactory::get_instance()->create_participant(0, participantQos);
+        participant_ = ChatParticipant::acquire();
 
         if (participant_ == nullptr) {
             return false;
         }
 
-        type_.register_type(participant_);
+        // Messages go straight to the sync and the receipts, so they exist before any reader does
+        sync.reset(new SyncRequester(topic_name,
+            [this]() { syncFromPeer(); },
+            [this](uint32_t first, uint32_t last, const std::string& sender, const std::vector<std::string>& messages) {
+                syncBatch(first, last, sender, messages);
+            }));
+        receipts.reset(new ReceiptSender(topic_name));
+
+        if (!sync->init(participant_) || !receipts->init(participant_)) {
+            return false;
+        }
 
         // Creates topic named after the user/group Subscriber will look for
         topic_ = participant_->create_topic(topic_name, "UserChat", TOPIC_QOS_DEFAULT);
@@ -156,42 +260,109 @@ public:
             return false;
         }
 
-        subscriber_ = participant_->create_subscriber(SUBSCRIBER_QOS_DEFAULT, nullptr);
+        subscriber_ = participant_->create_subscriber(chatSubscriberQos(chatConfig()), nullptr);
 
         if (subscriber_ == nullptr)
         {
             return false;
         }
 
-        reader_ = subscriber_->create_datareader(topic_, DATAREADER_QOS_DEFAULT, &listener_);
+        DataReaderQos readerQos = DATAREADER_QOS_DEFAULT;
+        applyQosProfile(readerQos, subscriber_, chatConfig());
+        applySendQueue(readerQos, chatConfig());
+        applyDataRepresentation(readerQos, chatConfig());
+
+        reader_ = subscriber_->create_datareader(topic_, readerQos, &listener_);
 
         if (reader_ == nullptr)
         {
             return false;
         }
 
+        urgent_topic_ = participant_->create_topic(topic_name + "_urgent", "UserChat", TOPIC_QOS_DEFAULT);
+
+        if (urgent_topic_ == nullptr)
+        {
+            return false;
+        }
+
+        DataReaderQos urgentQos = DATAREADER_QOS_DEFAULT;
+        applyUrgentQos(urgentQos);
+        applyDataRepresentation(urgentQos, chatConfig());
+
+        urgent_reader_ = subscriber_->create_datareader(urgent_topic_, urgentQos, &urgent_listener_);
+
+        if (urgent_reader_ == nullptr)
+        {
+            return false;
+        }
+
         return true;
     }
 
+    // Shows and stores a received message, runs on the task pool in the order messages arrived.
+    // Copies that already came through a sync are dropped, a gap asks the sender for what's missing.
+    // Urgent messages share the numbering but can overtake normal ones still queued at the
+    // sender, so only a normal message that arrives ahead of the rest counts as a gap.
+    void process(uint32_t index, const eprosima::fastdds::rtps::InstanceHandle_t& writer, std::string sender, std::string message, bool urgent) {
+        strand.post([this, index, writer, sender, message, urgent]() {
+            CHAT_TRACE_SPAN_ARG("deliver", "index", index);
+
+            if (urgent) {
+                processUrgent(index, writer, sender, message);
+                return;
+            }
+
+            // A new writer starting from 1 lost its outbox, count from scratch
+            if (index == 1 && writer != live_writer) {
+                last_seen = 0;
+                seen_ahead.clear();
+                sync_target = 0;
+                last_read = 0;
+            }
+            live_writer = writer;
+
+            if (!markSeen(index)) return;
+
+            if (last_seen < index && last_seen >= sync_target) {
+                sync_target = index - 1;
+                sync->request(last_seen, sync_target);
+            }
+
+            deliver(sender, message);
+            receipts->update(last_seen, last_read);
+        });
+    }
+
+    // The user opened this chat, so everything that arrived so far counts as read
+    void markRead() {
+        strand.post([this]() {
+            last_read = last_seen;
+            receipts->update(last_seen, last_read);
+        });
+    }
+
     std::string getTopicName() {
         return topic_name;
     }
 
-    std::vector<std::string>* getHistory() {
+    // The chat readers created by init(), for their statistics
+    std::vector<eprosima::fastdds::rtps::GUID_t> getReaderGuids() const {
+        std::vector<eprosima::fastdds::rtps::GUID_t> guids;
+
+        if (reader_ != nullptr) guids.push_back(reader_->guid());
+        if (urgent_reader_ != nullptr) guids.push_back(urgent_reader_->guid());
+
+        return guids;
+    }
+
+    ChatHistory* getHistory() {
         return history;
     }
 
     std::vector<std::string>* getCurrTab() {
         return curr_tab;
     }
+};
 
-    // Need a separate topic, topic_name address is weird
-    void run(std::string topic) {
-        while (true) {
-            if (std::find(endThreadSignal.begin(), endThreadSignal.end(), topic) != endThreadSignal.end()) break;
-            //if (std::find(end_signal->begin(), end_signal->end(), topic_name) != end_signal->end()) break;
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        }
-    }
-};
\ No newline at end of file
+#endif
\ No newline at end of file